@@ -0,0 +1,180 @@
+#ifndef IGGYLABS_CYCLE_DETECT_HPP
+#define IGGYLABS_CYCLE_DETECT_HPP
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define DETECT_CYCLE_LENGTH 0  // Passed as the cycle length to have the loader work it out
+#define DETECT_WINDOW 16384    // Samples per analysis window, eight of the longest cycles
+#define DETECT_WINDOWS 4       // Windows spread across the file
+#define DETECT_TOLERANCE 0.05  // Shorter lengths within this much of the best correlation win
+#define DETECT_MIN_SCORE 0.5   // Below this the file has no clear period
+
+
+namespace Wavetable {
+
+    enum CycleLengthSource {
+        CHOSEN_LENGTH,    // Picked in the menu, or saved with the patch
+        METADATA_LENGTH,  // Read from the file's `clm ` or `srge` chunk
+        DETECTED_LENGTH,  // Found by analyzing the samples
+        GUESSED_LENGTH,   // Nothing to go on; the default length
+        NUM_LENGTH_SOURCES
+    };
+
+    static inline uint32_t readLE32(const unsigned char* bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+    }
+
+    // Samples per cycle as written by the wavetable's editor, or 0 if the file doesn't say.
+    // Serum writes a `clm ` chunk whose text starts "<!>2048"; Surge writes a `srge` chunk
+    // holding a version and the cycle length as 32-bit integers.
+    inline int metadataCycleLength(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return 0;
+        }
+        int length = 0;
+        unsigned char header[12];
+        if (fread(header, 1, 12, file) == 12 && !memcmp(header, "RIFF", 4) && !memcmp(header + 8, "WAVE", 4)) {
+            unsigned char chunk[8];
+            while (!length && fread(chunk, 1, 8, file) == 8) {
+                uint32_t size = readLE32(chunk + 4);
+                long next = ftell(file) + size + (size & 1);  // Chunks are padded to even sizes
+                if (!memcmp(chunk, "clm ", 4) && size < 256) {
+                    char text[256] = {};
+                    if (fread(text, 1, size, file) == size && !strncmp(text, "<!>", 3)) {
+                        length = atoi(text + 3);
+                    }
+                } else if (!memcmp(chunk, "srge", 4) && size >= 8) {
+                    unsigned char data[8];
+                    if (fread(data, 1, 8, file) == 8) {
+                        length = (int) readLE32(data + 4);
+                    }
+                } else if (!memcmp(chunk, "data", 4)) {
+                    // Editors write their chunks ahead of the samples; don't read past them
+                    break;
+                }
+                if (fseek(file, next, SEEK_SET) != 0) {
+                    break;
+                }
+            }
+        }
+        fclose(file);
+        return length;
+    }
+
+    // Normalized autocorrelation of one window at each of `lags`, through an FFT of the
+    // zero-padded window. Each lag is normalized over the samples that overlap at it.
+    inline std::vector<double> windowCorrelation(const float* samples, int count, const std::vector<int>& lags) {
+        int size = 1;
+        while (size < 2 * count) {
+            size <<= 1;
+        }
+        double mean = 0.0;
+        for (int n = 0; n < count; n++) {
+            mean += samples[n];
+        }
+        mean /= count;
+
+        std::vector<double> re(size, 0.0), im(size, 0.0);
+        std::vector<double> energy(count + 1, 0.0);  // Running sum of squares
+        for (int n = 0; n < count; n++) {
+            re[n] = samples[n] - mean;
+            energy[n + 1] = energy[n] + re[n] * re[n];
+        }
+        fft(size, re.data(), im.data());
+        // Power spectrum, then back through the forward `fft`; it is real and even, so the
+        // transform comes out as the autocorrelation times `size`
+        for (int k = 0; k < size; k++) {
+            re[k] = re[k] * re[k] + im[k] * im[k];
+            im[k] = 0.0;
+        }
+        fft(size, re.data(), im.data());
+
+        std::vector<double> scores(lags.size(), 0.0);
+        for (int i = 0; i < (int) lags.size(); i++) {
+            int lag = lags[i];
+            if (lag >= count) {
+                continue;
+            }
+            double head = energy[count - lag];
+            double tail = energy[count] - energy[lag];
+            if (head > 0.0 && tail > 0.0) {
+                scores[i] = re[lag] / size / sqrt(head * tail);
+            }
+        }
+        return scores;
+    }
+
+    // Which of `lengths` the samples repeat at, judged by the autocorrelation of a few windows
+    // spread across the file, which are analyzed on all cores at once. Smooth samples
+    // correlate at any short lag, so a length only counts if the samples correlate better
+    // there than three quarters of the way to it. A length and its multiples all correlate,
+    // so the shortest that correlates about as well as the best wins. Returns 0 if none
+    // stands out.
+    inline int detectCycleLength(const float* samples, int count, const std::vector<int>& lengths) {
+        std::vector<int> candidates;
+        for (int length : lengths) {
+            // Editors write whole cycles, so a length that doesn't divide the file is unlikely
+            if (length * 2 <= count && count % length == 0) {
+                candidates.push_back(length);
+            }
+        }
+        if (candidates.empty()) {
+            for (int length : lengths) {
+                if (length * 2 <= count) {
+                    candidates.push_back(length);
+                }
+            }
+        }
+        if (candidates.empty()) {
+            return 0;
+        }
+
+        // Each candidate's lag, then the lag three quarters of the way to it
+        int numCandidates = candidates.size();
+        std::vector<int> lags(candidates);
+        for (int length : candidates) {
+            lags.push_back(length * 3 / 4);
+        }
+
+        int window = std::min(count, DETECT_WINDOW);
+        int windows = std::max(1, std::min(DETECT_WINDOWS, count / window));
+        std::vector<std::vector<double>> scores(windows);
+        parallelFor(windows, [&](int w) {
+            int start = windows > 1 ? (int) ((int64_t) (count - window) * w / (windows - 1)) : 0;
+            scores[w] = windowCorrelation(samples + start, window, lags);
+        });
+
+        std::vector<double> totals(lags.size(), 0.0);
+        for (int i = 0; i < (int) lags.size(); i++) {
+            for (int w = 0; w < windows; w++) {
+                totals[i] += scores[w][i] / windows;
+            }
+        }
+        double best = -1.0;
+        for (int i = 0; i < numCandidates; i++) {
+            if (totals[i] > totals[numCandidates + i]) {
+                best = std::max(best, totals[i]);
+            }
+        }
+        if (best < DETECT_MIN_SCORE) {
+            return 0;
+        }
+        for (int i = 0; i < numCandidates; i++) {
+            if (totals[i] > totals[numCandidates + i] && totals[i] >= best - DETECT_TOLERANCE) {
+                return candidates[i];
+            }
+        }
+        return 0;
+    }
+
+} // namespace Wavetable
+
+#endif
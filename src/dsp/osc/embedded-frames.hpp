@@ -0,0 +1,118 @@
+#ifndef IGGYLABS_EMBEDDED_FRAMES_HPP
+#define IGGYLABS_EMBEDDED_FRAMES_HPP
+
+#include <limits.h>
+#include <math.h>
+#include <exception>
+#include <string>
+#include <vector>
+
+#define EMBED_SCALE 32767.f   // 16-bit steps from the table's peak to silence
+#define EMBED_MAX_RATIO 1032  // Most that zlib can expand its input by
+
+
+namespace Wavetable {
+
+    // A table's source cycles packed small enough to save in a patch, so it can be rebuilt
+    // without the file. Samples are rounded to 16 bits of the table's peak and stored as the
+    // difference from the sample before, low bytes then high bytes, which smooth cycles
+    // compress well; the result is zlib-compressed and base64-encoded.
+    struct EmbeddedFrames {
+        int sourceLength = 0;  // Samples per cycle
+        int cycles = 0;        // Cycles per side
+        int sides = 0;         // 0 if nothing is embedded
+        float peak = 1.f;      // Level of the loudest sample, which 16-bit samples are relative to
+        uint64_t hash = 0;     // FNV-1a of the 16-bit samples, checked when they are unpacked
+        std::string data;
+
+        bool empty() const {
+            return sides == 0;
+        }
+
+        // Packs the first `cycles` cycles of `length` samples from each side
+        void pack(const std::vector<std::vector<float>>& sideSamples, int length, int count) {
+            sourceLength = length;
+            cycles = count;
+            sides = sideSamples.size();
+            size_t n = (size_t) length * count;
+
+            peak = 0.f;
+            for (const std::vector<float>& samples : sideSamples) {
+                for (size_t i = 0; i < n; i++) {
+                    peak = std::max(peak, std::fabs(samples[i]));
+                }
+            }
+            if (!(peak > 0.f)) {
+                peak = 1.f;
+            }
+
+            std::vector<uint8_t> bytes(2 * n * sides);
+            uint8_t* low = bytes.data();
+            uint8_t* high = low + n * sides;
+            uint16_t last = 0;
+            hash = 14695981039346656037ULL;
+            size_t k = 0;
+            for (const std::vector<float>& samples : sideSamples) {
+                for (size_t i = 0; i < n; i++, k++) {
+                    int16_t q = (int16_t) lrintf(clamp(samples[i] / peak, -1.f, 1.f) * EMBED_SCALE);
+                    hash = hashSample(hash, q);
+                    uint16_t delta = (uint16_t) q - last;
+                    last = (uint16_t) q;
+                    low[k] = delta & 0xff;
+                    high[k] = delta >> 8;
+                }
+            }
+            std::vector<uint8_t> compressed = string::compress(bytes.data(), bytes.size());
+            data = string::toBase64(compressed.data(), compressed.size());
+        }
+
+        // Unpacks into `sides` runs of samples, or returns false if the data is damaged. The
+        // counts come from the patch, so nothing is allocated for them until the payload
+        // could really hold that many samples.
+        bool unpack(std::vector<std::vector<float>>* sideSamples) const {
+            if (empty() || sourceLength < 1 || cycles < 1) {
+                return false;
+            }
+            size_t n = (size_t) sourceLength * cycles;
+            std::vector<uint8_t> bytes;
+            try {
+                std::vector<uint8_t> compressed = string::fromBase64(data);
+                if (n > (size_t) (INT_MAX / sides) || 2 * n * sides > compressed.size() * EMBED_MAX_RATIO) {
+                    return false;
+                }
+                bytes.resize(2 * n * sides);
+                size_t length = bytes.size();
+                string::uncompress(compressed.data(), compressed.size(), bytes.data(), &length);
+                if (length != bytes.size()) {
+                    return false;
+                }
+                sideSamples->assign(sides, std::vector<float>(n));
+            } catch (std::exception& e) {
+                return false;
+            }
+
+            const uint8_t* low = bytes.data();
+            const uint8_t* high = low + n * sides;
+            uint16_t last = 0;
+            uint64_t check = 14695981039346656037ULL;
+            size_t k = 0;
+            for (std::vector<float>& samples : *sideSamples) {
+                for (size_t i = 0; i < n; i++, k++) {
+                    last += (uint16_t) (low[k] | high[k] << 8);
+                    int16_t q = (int16_t) last;
+                    check = hashSample(check, q);
+                    samples[i] = q * (peak / EMBED_SCALE);
+                }
+            }
+            return check == hash;
+        }
+
+        static uint64_t hashSample(uint64_t hash, int16_t q) {
+            hash = (hash ^ (q & 0xff)) * 1099511628211ULL;
+            return (hash ^ ((q >> 8) & 0xff)) * 1099511628211ULL;
+        }
+    };
+
+} // namespace Wavetable
+
+#endif
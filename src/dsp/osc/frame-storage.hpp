@@ -0,0 +1,413 @@
+#ifndef IGGYLABS_FRAME_STORAGE_HPP
+#define IGGYLABS_FRAME_STORAGE_HPP
+
+#include <math.h>
+#include <array>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+#if defined ARCH_LIN
+#include <sys/mman.h>
+#elif defined ARCH_WIN
+#include <malloc.h>
+#endif
+
+#define MAX_MIP_LEVELS 16
+#define FRAME_ALIGNMENT 64           // One cache line
+#define HUGE_PAGE_SIZE (2 << 20)     // x86-64 transparent huge page
+#define INT16_RANGE 2.f              // Bandlimited levels can overshoot the 0.999 full-band peak
+#define MIN_INT16_SNR 80.f           // Below these a compact table is kept as float instead
+#define MIN_HALF_SNR 70.f
+
+
+namespace Wavetable {
+
+    // 64-byte aligned block, backed by transparent huge pages on Linux once it is big enough
+    // to fill one. Huge pages cut the TLB misses of scanning a large table.
+    inline void* allocateFrames(size_t bytes) {
+        void* block = nullptr;
+#if defined ARCH_WIN
+        block = _aligned_malloc(bytes, FRAME_ALIGNMENT);
+#elif defined ARCH_LIN
+        if (bytes >= HUGE_PAGE_SIZE) {
+            bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            if (posix_memalign(&block, HUGE_PAGE_SIZE, bytes) == 0) {
+                madvise(block, bytes, MADV_HUGEPAGE);
+            } else {
+                block = nullptr;
+            }
+        } else if (posix_memalign(&block, FRAME_ALIGNMENT, bytes) != 0) {
+            block = nullptr;
+        }
+#else
+        if (posix_memalign(&block, FRAME_ALIGNMENT, bytes) != 0) {
+            block = nullptr;
+        }
+#endif
+        return block;
+    }
+
+    inline void freeFrames(void* block) {
+#if defined ARCH_WIN
+        _aligned_free(block);
+#else
+        free(block);
+#endif
+    }
+
+    enum StorageFormat {
+        FLOAT_STORAGE,
+        INT16_STORAGE,
+        HALF_STORAGE,
+        NUM_STORAGE_FORMATS
+    };
+
+    // IEEE 754 binary16, kept apart from int16_t so lookups can be specialized on it
+    struct Half {
+        uint16_t bits;
+    };
+
+    inline uint16_t floatToHalf(float f) {
+        uint32_t x;
+        memcpy(&x, &f, sizeof(x));
+        uint16_t sign = (x >> 16) & 0x8000;
+        int exponent = (int) ((x >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = x & 0x7fffff;
+
+        if (exponent <= 0) {
+            // Subnormal, rounded to nearest
+            if (exponent < -10) {
+                return sign;
+            }
+            mantissa |= 0x800000;
+            int shift = 14 - exponent;
+            uint16_t half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1) {
+                half++;
+            }
+            return sign | half;
+        }
+        if (exponent >= 31) {
+            return sign | 0x7c00;
+        }
+        // Rounding may carry into the exponent, which is still the right answer
+        uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000) {
+            half++;
+        }
+        return half;
+    }
+
+    inline float halfToFloat(uint16_t half) {
+        // Move exponent and mantissa into place, then rebias the exponent (2^112) with a
+        // multiply, which also gets subnormals right
+        uint32_t bits = (uint32_t) (half & 0x7fff) << 13;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        f *= 5.192296858534828e33f;
+        memcpy(&bits, &f, sizeof(bits));
+        bits |= (uint32_t) (half & 0x8000) << 16;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    inline float widen(float sample, float gain) {
+        return sample;
+    }
+
+    inline float widen(int16_t sample, float gain) {
+        return sample * gain;
+    }
+
+    inline float widen(Half sample, float gain) {
+        return halfToFloat(sample.bits);
+    }
+
+    // Every bandlimited table of a loaded wavetable in one block, laid out as
+    // [mip level][frame][sample] so the frames a voice scans through at a given pitch sit
+    // next to each other in memory.
+    //
+    // Mip levels are shared by all frames: mip 0 holds every harmonic up to the table's
+    // highest, and each level above drops the upper half (one table per octave, after
+    // Nigel Redmon's earlevel oscillator). Levels above the one that covers the highest
+    // frequency the oscillator can play are never built.
+    //
+    // Samples are float, or int16/half in the compact formats at half the memory. Compact
+    // samples are widened back to float as the voice loop gathers them.
+    //
+    // Tables are content-addressed: repeated or silent frames, and upper levels that come
+    // out the same for several frames (a pure fundamental, say), are stored once. `rows`
+    // maps each [mip level][frame] to its table in the block.
+    struct FrameStorage {
+        int cycleLength = 0;
+        int numFrames = 0;
+        int numMips = 0;
+        int maxHarmonic = 0;  // Highest harmonic in mip 0
+        int format = FLOAT_STORAGE;
+        int sampleSize = sizeof(float);
+        int stride = 0;       // Samples per table: the cycle, its wraparound sample and padding
+        int numRows = 0;      // Unique tables actually stored
+        size_t bytes = 0;
+        void* samples = nullptr;
+        std::vector<uint32_t> rows;
+
+        float gain = 1.f;     // Scales int16 samples back to float
+        float snr = INFINITY; // Of the compact format against float, measured while building
+        bool lowSnr = false;  // Kept as float because the compact format measured too noisy
+
+        // What the frames are a table of. The Wavetable fills this in before it publishes the
+        // frames, and the audio thread reads it through the same pointer, so it never plays
+        // one table's frames by another's counts. Pages leave it as it is.
+        struct TableCounts {
+            int numCycles = 1;     // Per side, of the first table of a bank
+            int sourceCycles = 1;  // Before upsampling
+            int numChannels = 1;   // Sides
+            int numTables = 1;
+            std::array<int, MAX_TABLES> tableFirst {};
+            std::array<int, MAX_TABLES> tableCycles {};
+        };
+        TableCounts counts;
+
+        // Highest normalized frequency each mip level is played at
+        double topFreqs[MAX_MIP_LEVELS];
+        // The same boundaries as pitches (V/oct from C4) at the engine's sample rate
+        float mipPitches[MAX_MIP_LEVELS];
+
+        FrameStorage(int cycleLength, int numFrames, int maxHarmonic, int format = FLOAT_STORAGE, double maxFreqNormal = 0.5) {
+            this->cycleLength = cycleLength;
+            this->numFrames = numFrames;
+            this->maxHarmonic = maxHarmonic;
+            this->format = format;
+            sampleSize = format == FLOAT_STORAGE ? sizeof(float) : sizeof(int16_t);
+            gain = INT16_RANGE / 32767.f;
+
+            // Maximum non-aliasing playback rate is 1 / (2 * maxHarmonic), but we allow aliasing up to the
+            // point where the aliased harmonic would meet the next octave table, which is an additional 1/3
+            numMips = mipLevels(maxHarmonic, maxFreqNormal);
+            for (int mip = 0; mip < numMips; mip++) {
+                topFreqs[mip] = maxHarmonic ? 2.0 / 3.0 / (maxHarmonic >> mip) : 1.0;
+            }
+            setSampleRate(44100.f);
+
+            int samplesPerLine = FRAME_ALIGNMENT / sampleSize;
+            stride = (cycleLength + 1 + samplesPerLine - 1) / samplesPerLine * samplesPerLine;
+            rows.assign((size_t) numMips * numFrames, 0);
+        }
+
+        // Levels needed to play up to `maxFreqNormal`. A silent table gets a single level of
+        // zeros, which covers every pitch.
+        static int mipLevels(int maxHarmonic, double maxFreqNormal) {
+            int levels = 0;
+            for (int harmonics = maxHarmonic; harmonics && levels < MAX_MIP_LEVELS; harmonics >>= 1) {
+                levels++;
+                if (2.0 / 3.0 / harmonics > maxFreqNormal) {
+                    break;
+                }
+            }
+            return std::max(levels, 1);
+        }
+
+        void setSampleRate(float sampleRate) {
+            for (int mip = 0; mip < numMips; mip++) {
+                mipPitches[mip] = log2(topFreqs[mip] * sampleRate / dsp::FREQ_C4);
+            }
+        }
+
+        // Sizes the block once the builder knows how many unique tables there are. Returns
+        // false if there isn't the memory for it.
+        bool allocate(int uniqueRows) {
+            numRows = uniqueRows;
+            size_t blockBytes = (size_t) numRows * stride * sampleSize;
+            samples = allocateFrames(blockBytes);
+            if (!samples) {
+                return false;
+            }
+            memset(samples, 0, blockBytes);
+            bytes = blockBytes + rows.size() * sizeof(uint32_t);
+            return true;
+        }
+
+        ~FrameStorage() {
+            freeFrames(samples);
+        }
+
+        template <typename T>
+        const T* table(int mip, int frame) const {
+            return (const T*) samples + (size_t) rows[mip * numFrames + frame] * stride;
+        }
+
+        int numTables() const {
+            return numMips * numFrames;
+        }
+
+        // Memory that storing every table separately would have taken on top of `bytes`
+        size_t sharedBytes() const {
+            return (size_t) (numTables() - numRows) * stride * sampleSize;
+        }
+
+        // Widened copy of one table, `cycleLength + 1` samples
+        void read(int mip, int frame, float* out) const {
+            for (int i = 0; i <= cycleLength; i++) {
+                switch (format) {
+                    case INT16_STORAGE: out[i] = widen(table<int16_t>(mip, frame)[i], gain); break;
+                    case HALF_STORAGE: out[i] = widen(table<Half>(mip, frame)[i], gain); break;
+                    default: out[i] = table<float>(mip, frame)[i]; break;
+                }
+            }
+        }
+
+        // Narrows one rendered table into its row, returning the squared error it introduced
+        double write(int row, const float* in) {
+            size_t offset = (size_t) row * stride;
+            double error = 0.0;
+            for (int i = 0; i <= cycleLength; i++) {
+                float stored;
+                switch (format) {
+                    case INT16_STORAGE: {
+                        int16_t q = (int16_t) roundf(clamp(in[i] / gain, -32767.f, 32767.f));
+                        ((int16_t*) samples)[offset + i] = q;
+                        stored = widen(q, gain);
+                    } break;
+                    case HALF_STORAGE: {
+                        Half h = { floatToHalf(in[i]) };
+                        ((Half*) samples)[offset + i] = h;
+                        stored = widen(h, gain);
+                    } break;
+                    default: {
+                        ((float*) samples)[offset + i] = in[i];
+                        stored = in[i];
+                    } break;
+                }
+                error += (double) (in[i] - stored) * (in[i] - stored);
+            }
+            return error;
+        }
+
+        int harmonics(int mip) const {
+            return maxHarmonic >> mip;
+        }
+
+        // Mip level of a voice: the number of level boundaries below its pitch
+        int mipFor(float pitch) const {
+            int mip = 0;
+            for (int level = 0; level < numMips - 1; level++) {
+                mip += pitch >= mipPitches[level];
+            }
+            return mip;
+        }
+    };
+
+    // FNV-1a over harmonics 1..`harmonics` of a spectrum, which is all a table rendered
+    // with that many harmonics depends on
+    inline uint64_t hashSpectrum(const FrameSpectrum& spectrum, int harmonics) {
+        uint64_t hash = 14695981039346656037ULL;
+        const unsigned char* bytes[2] = {
+            (const unsigned char*) (spectrum.magnitude.data() + 1),
+            (const unsigned char*) (spectrum.phase.data() + 1)
+        };
+        for (const unsigned char* p : bytes) {
+            for (size_t i = 0; i < harmonics * sizeof(float); i++) {
+                hash = (hash ^ p[i]) * 1099511628211ULL;
+            }
+        }
+        return hash ^ (uint64_t) harmonics;
+    }
+
+    inline bool sameSpectrum(const FrameSpectrum& a, const FrameSpectrum& b, int harmonics) {
+        return harmonics == 0
+            || (memcmp(a.magnitude.data() + 1, b.magnitude.data() + 1, harmonics * sizeof(float)) == 0
+                && memcmp(a.phase.data() + 1, b.phase.data() + 1, harmonics * sizeof(float)) == 0);
+    }
+
+    // Renders every mip level of every frame from their cached spectra, once per distinct
+    // table. For compact formats, the signal-to-noise ratio against the float rendering is
+    // measured on the way. Returns nullptr if there isn't the memory for the table.
+    //
+    // `maxHarmonic` sets the mip levels, and frames are cut off above it; 0 takes it from
+    // the frames themselves. Pages of a longer table pass the whole table's, so all of them
+    // share its levels. `tilt` darkens every table, see morphSpectrum.
+    //
+    // With `checkSnr`, a table that comes out noisier than MIN_INT16_SNR or MIN_HALF_SNR (in
+    // int16, narrow pulses whose level sits far below their peak) is built as float instead.
+    // Pages leave it off, since they are read in their preview's format.
+    inline FrameStorage* buildFrameStorage(const FrameSpectrum* spectra, int numFrames, int cycleLength, int format = FLOAT_STORAGE,
+                                           double maxFreqNormal = 0.5, int maxHarmonic = 0, float tilt = 0.f, bool checkSnr = false) {
+        if (maxHarmonic == 0) {
+            for (int frame = 0; frame < numFrames; frame++) {
+                maxHarmonic = std::max(maxHarmonic, spectra[frame].maxHarmonic);
+            }
+        }
+
+        FrameStorage* storage = new FrameStorage(cycleLength, numFrames, maxHarmonic, format, maxFreqNormal);
+
+        // A level's table only depends on the frame's harmonics up to the level's limit, so
+        // that truncated spectrum is the table's address. Level by level, frame by frame, so
+        // unique tables keep the [mip][frame] order.
+        struct Row {
+            int frame;
+            int harmonics;
+        };
+        std::vector<Row> unique;
+        std::unordered_map<uint64_t, std::vector<int>> index;
+        for (int mip = 0; mip < storage->numMips; mip++) {
+            for (int frame = 0; frame < numFrames; frame++) {
+                const FrameSpectrum& spectrum = spectra[frame];
+                int harmonics = std::min(storage->harmonics(mip), spectrum.maxHarmonic);
+
+                std::vector<int>& candidates = index[hashSpectrum(spectrum, harmonics)];
+                int row = -1;
+                for (int candidate : candidates) {
+                    const Row& other = unique[candidate];
+                    if (other.harmonics == harmonics && sameSpectrum(spectra[other.frame], spectrum, harmonics)) {
+                        row = candidate;
+                        break;
+                    }
+                }
+                if (row < 0) {
+                    row = unique.size();
+                    unique.push_back({ frame, harmonics });
+                    candidates.push_back(row);
+                }
+                storage->rows[mip * numFrames + frame] = row;
+            }
+        }
+        if (!storage->allocate(unique.size())) {
+            delete storage;
+            return nullptr;
+        }
+
+        std::vector<double> ar(cycleLength), ai(cycleLength);
+        std::vector<float> out(cycleLength + 1);
+        double signal = 0.0;
+        double noise = 0.0;
+        for (int row = 0; row < storage->numRows; row++) {
+            const FrameSpectrum& spectrum = spectra[unique[row].frame];
+            morphSpectra(spectrum, spectrum, 0.f, unique[row].harmonics, ar.data(), ai.data(), out.data(), tilt);
+            noise += storage->write(row, out.data());
+            for (int i = 0; i <= cycleLength; i++) {
+                signal += (double) out[i] * out[i];
+            }
+        }
+
+        if (noise > 0.0) {
+            storage->snr = 10.f * log10(signal / noise);
+        }
+        float minSnr = format == INT16_STORAGE ? MIN_INT16_SNR : MIN_HALF_SNR;
+        if (checkSnr && format != FLOAT_STORAGE && storage->snr < minSnr) {
+            // Twice the memory, so the compact table stays if float doesn't fit
+            FrameStorage* fallback = buildFrameStorage(spectra, numFrames, cycleLength, FLOAT_STORAGE, maxFreqNormal, maxHarmonic, tilt);
+            if (fallback) {
+                fallback->snr = storage->snr;
+                fallback->lowSnr = true;
+                delete storage;
+                storage = fallback;
+            }
+        }
+        return storage;
+    }
+
+} // namespace Wavetable
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef IGGYLABS_MORPH_CACHE_HPP
+#define IGGYLABS_MORPH_CACHE_HPP
+
+#include <atomic>
+#include <math.h>
+
+#define MORPH_CACHE_THRESHOLD 0.002f  // Position drift (fraction of a frame) before a bake is stale
+
+
+namespace Wavetable {
+
+    enum MorphMode {
+        LINEAR_MORPH,    // Crossfade neighbouring frames sample by sample
+        SPECTRAL_MORPH,  // Interpolate harmonic magnitudes and phases, then resynthesize
+        NUM_MORPH_MODES
+    };
+
+    // Per-voice bake of the morphed frame at one table position and mip level, so a voice
+    // parked between two frames does a single table lookup instead of two plus a lerp.
+    //
+    // Two buffers: the audio thread reads the published one, the worker writes the other and
+    // then flips `published`. A request is only made after the audio thread has seen the
+    // latest flip, so the worker never writes a buffer the audio thread is still reading.
+    struct MorphCache {
+        enum State {
+            IDLE,
+            REQUESTED,
+            BUILDING
+        };
+
+        struct Key {
+            int generation = -1;  // Which loaded table the bake belongs to
+            int mode = LINEAR_MORPH;
+            int frame = 0;        // Lower of the two frames being morphed
+            int mip = 0;
+            int harmonics = 0;    // Highest harmonic that is alias-free at this mip level
+            float frac = 0.f;
+        };
+
+        std::atomic<int> state { IDLE };
+        std::atomic<int> published { -1 };
+
+        Key requested;  // Written by the audio thread before REQUESTED
+        Key baked[2];   // Written by the worker before publishing
+        float buffers[2][MAX_CYCLE_LENGTH + 1];
+
+        bool covers(int slot, const Key& key) const {
+            const Key& b = baked[slot];
+            return key.generation == b.generation
+                && key.mode == b.mode
+                && key.frame == b.frame
+                && key.mip == b.mip
+                && fabsf(key.frac - b.frac) < MORPH_CACHE_THRESHOLD;
+        }
+
+        // A spectral bake from a nearby position is still a better stand-in than a linear
+        // crossfade while the worker catches up, as long as it cannot alias
+        bool canHold(int slot, const Key& key) const {
+            const Key& b = baked[slot];
+            return key.mode == SPECTRAL_MORPH
+                && key.generation == b.generation
+                && key.mode == b.mode
+                && b.harmonics <= key.harmonics;
+        }
+
+        // Audio thread: ask for a new bake unless one is already in flight. `slot` is what it
+        // loaded `published` as; a bake published since has to be seen first, or the next
+        // bake would go into the buffer the audio thread is still reading.
+        void request(const Key& key, int slot) {
+            if (state.load(std::memory_order_acquire) == IDLE && published.load(std::memory_order_relaxed) == slot) {
+                requested = key;
+                state.store(REQUESTED, std::memory_order_release);
+            }
+        }
+
+        // Worker: claim a pending request, returns false if there is none
+        bool claim() {
+            int expected = REQUESTED;
+            return state.compare_exchange_strong(expected, BUILDING, std::memory_order_acquire);
+        }
+
+        // Worker: the buffer not currently visible to the audio thread
+        float* back() {
+            return buffers[backSlot()];
+        }
+
+        void publish(const Key& key) {
+            int slot = backSlot();
+            baked[slot] = key;
+            published.store(slot, std::memory_order_release);
+            state.store(IDLE, std::memory_order_release);
+        }
+
+        // Worker: drop a request that no longer applies
+        void cancel() {
+            state.store(IDLE, std::memory_order_release);
+        }
+
+        int backSlot() const {
+            return published.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+        }
+    };
+
+} // namespace Wavetable
+
+#endif
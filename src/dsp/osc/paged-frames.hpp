@@ -0,0 +1,216 @@
+#ifndef IGGYLABS_PAGED_FRAMES_HPP
+#define IGGYLABS_PAGED_FRAMES_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#define FRAMES_PER_PAGE 32
+#define RESIDENT_PAGES 16    // Pages kept bandlimited at once, 512 frames
+
+
+namespace Wavetable {
+
+    // Bandlimited frames of a table too long to build in full (more than MAX_CYCLE_COUNT
+    // frames). Frames are built a page at a time on the worker, and only the pages voices
+    // are reading, plus their neighbours, are kept. Until its page is in, a frame plays as
+    // the first frame of its page, from a small preview table the caller keeps resident
+    // (preview frame `p` is the first frame of page `p`).
+    //
+    // Live capture and frame edits use the same store with one frame per page, publishing a
+    // frame's page whenever it is captured or edited; frames without a page read the table
+    // underneath as their preview.
+    //
+    // The audio thread only loads page pointers and stamps the pages it reads. Building,
+    // eviction and freeing all happen on the worker, and a replaced or evicted page is only
+    // freed once the audio thread has finished the call that may still be reading it.
+    struct FramePages {
+        int numFrames = 0;
+        int framesPerPage = FRAMES_PER_PAGE;
+        int numPages = 0;
+        bool paged = true;  // Built on demand by update(), rather than published directly
+
+        std::unique_ptr<std::atomic<FrameStorage*>[]> pages;
+        std::unique_ptr<std::atomic<uint32_t>[]> stamps;  // `clock` when each page was last read
+        std::atomic<uint32_t> clock { 1 };                  // Audio thread calls finished
+
+        std::atomic<int> residentPages { 0 };
+        std::atomic<size_t> residentBytes { 0 };
+
+        // Worker only
+        struct Retired {
+            FrameStorage* page;
+            uint32_t clock;  // Freed once the audio thread has moved past this
+        };
+        std::vector<Retired> retired;
+        std::vector<bool> playing;
+        uint32_t lastPass = 1;
+
+        FramePages(int numFrames, int framesPerPage = FRAMES_PER_PAGE) {
+            this->numFrames = numFrames;
+            this->framesPerPage = framesPerPage;
+            numPages = (numFrames + framesPerPage - 1) / framesPerPage;
+            pages.reset(new std::atomic<FrameStorage*>[numPages]);
+            stamps.reset(new std::atomic<uint32_t>[numPages]);
+            for (int page = 0; page < numPages; page++) {
+                pages[page].store(nullptr);
+                stamps[page].store(0);
+            }
+            playing.assign(numPages, false);
+        }
+
+        ~FramePages() {
+            for (int page = 0; page < numPages; page++) {
+                delete pages[page].load();
+            }
+            for (const Retired& r : retired) {
+                delete r.page;
+            }
+        }
+
+        int firstFrame(int page) const {
+            return page * framesPerPage;
+        }
+
+        int framesIn(int page) const {
+            return std::min(framesPerPage, numFrames - firstFrame(page));
+        }
+
+        bool resident(int frame) const {
+            return pages[frame / framesPerPage].load(std::memory_order_acquire) != nullptr;
+        }
+
+        // Audio thread: the frame's table from its page, or its page's stand-in from `preview`
+        template <typename T>
+        const T* table(const FrameStorage* preview, int mip, int frame) {
+            int page = frame / framesPerPage;
+            stamps[page].store(clock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            const FrameStorage* frames = pages[page].load(std::memory_order_acquire);
+            if (frames) {
+                return frames->table<T>(mip, frame - firstFrame(page));
+            }
+            return preview->table<T>(mip, page);
+        }
+
+        // Audio thread: marks the end of a call, after which it holds no page pointers
+        void tick() {
+            clock.store(clock.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Worker: widened copy of a frame's table, from whatever is resident
+        void read(const FrameStorage* preview, int mip, int frame, float* out) const {
+            int page = frame / framesPerPage;
+            const FrameStorage* frames = pages[page].load(std::memory_order_acquire);
+            if (frames) {
+                frames->read(mip, frame - firstFrame(page), out);
+            } else {
+                preview->read(mip, page, out);
+            }
+        }
+
+        // Worker: frees the retired pages the audio thread is done with
+        void collect() {
+            uint32_t now = clock.load(std::memory_order_acquire);
+            for (size_t i = 0; i < retired.size();) {
+                if (retired[i].clock != now) {
+                    delete retired[i].page;
+                    retired[i] = retired.back();
+                    retired.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        }
+
+        // Worker: brings in at most one page (a missing page that is being read first,
+        // otherwise a neighbour of one), then evicts the least recently read pages over
+        // budget. `build` renders `count` frames from `first`. Returns whether any page has
+        // been read since the last update.
+        bool update(std::function<FrameStorage*(int first, int count)> build) {
+            collect();
+            uint32_t now = clock.load(std::memory_order_acquire);
+
+            bool read = false;
+            for (int page = 0; page < numPages; page++) {
+                playing[page] = (int32_t) (stamps[page].load(std::memory_order_relaxed) - lastPass) >= 0;
+                read |= playing[page];
+            }
+            lastPass = now;
+
+            int target = -1;
+            for (int page = 0; page < numPages && target < 0; page++) {
+                if (playing[page] && !pages[page].load()) {
+                    target = page;
+                }
+            }
+            // Prefetch ahead of moving positions while there is room
+            for (int page = 0; page < numPages && target < 0 && residentPages < RESIDENT_PAGES; page++) {
+                if (!playing[page]) {
+                    continue;
+                }
+                if (page > 0 && !pages[page - 1].load()) {
+                    target = page - 1;
+                } else if (page + 1 < numPages && !pages[page + 1].load()) {
+                    target = page + 1;
+                }
+            }
+
+            if (target >= 0) {
+                publish(target, build(firstFrame(target), framesIn(target)));
+            }
+
+            while (residentPages > RESIDENT_PAGES) {
+                int oldest = -1;
+                uint32_t oldestAge = 0;
+                for (int page = 0; page < numPages; page++) {
+                    uint32_t age = now - stamps[page].load(std::memory_order_relaxed);
+                    if (!playing[page] && pages[page].load() && (oldest < 0 || age > oldestAge)) {
+                        oldest = page;
+                        oldestAge = age;
+                    }
+                }
+                if (oldest < 0) {
+                    break;
+                }
+                evict(oldest);
+            }
+            return read;
+        }
+
+        // Worker: makes `frames` the page's, retiring whatever it replaces
+        void publish(int page, FrameStorage* frames) {
+            if (!frames) {
+                // Out of memory: the page stays as it was, and update() tries it again
+                return;
+            }
+            evict(page);
+            residentPages++;
+            residentBytes += frames->bytes;
+            pages[page].store(frames, std::memory_order_release);
+        }
+
+        // Worker: drops every page, e.g. when the preview they are read against is rebuilt
+        void evictAll() {
+            for (int page = 0; page < numPages; page++) {
+                evict(page);
+            }
+        }
+
+        void evict(int page) {
+            FrameStorage* frames = pages[page].exchange(nullptr);
+            if (!frames) {
+                return;
+            }
+            residentPages--;
+            residentBytes -= frames->bytes;
+            // The pointer is gone first, so any call that could still hold it ends by the next tick
+            retired.push_back({ frames, clock.load() });
+        }
+    };
+
+} // namespace Wavetable
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef IGGYLABS_PHASE_WARP_HPP
+#define IGGYLABS_PHASE_WARP_HPP
+
+#define FORMANT_MAX_RATIO 8.f  // Cycles per period at full formant warp
+#define MAX_WARP_OCTAVES 3     // Mip levels are built this far past the highest pitch, for warps
+
+
+namespace Wavetable {
+
+    enum PhaseWarp {
+        NO_WARP,
+        BEND_WARP,     // Rush through the first half of the cycle and linger over the second
+        FORMANT_WARP,  // Play the cycle several times a period, restarting like hard sync
+        MIRROR_WARP,   // Play the cycle forwards, then back to the start
+        NUM_PHASE_WARPS
+    };
+
+    // Reshapes four voices' phases by `amount`, from 0 (no change) to 1, with the same
+    // arithmetic in every lane. `octaves` gets how much faster than the phasor the warped
+    // phase moves through the cycle at this point, so the lookup can read a mip level with
+    // fewer harmonics where the warp speeds it up, and not alias.
+    inline simd::float_4 warpPhase(int mode, simd::float_4 phase, simd::float_4 amount, simd::float_4* octaves) {
+        simd::float_4 warped = phase;
+        simd::float_4 slope = 1.f;
+        switch (mode) {
+            case BEND_WARP: {
+                // The first half of the cycle is squeezed into the phasor's first `knee`
+                simd::float_4 knee = 0.5f - 0.49f * amount;
+                simd::float_4 early = phase < knee;
+                simd::float_4 rise = 0.5f / knee;
+                simd::float_4 fall = 0.5f / (1.f - knee);
+                warped = simd::ifelse(early, phase * rise, 0.5f + (phase - knee) * fall);
+                slope = simd::ifelse(early, rise, fall);
+                break;
+            }
+            case FORMANT_WARP: {
+                slope = 1.f + (FORMANT_MAX_RATIO - 1.f) * amount;
+                warped = phase * slope;
+                break;
+            }
+            case MIRROR_WARP: {
+                // Forwards through the whole cycle by `turn`, then back again. With no warp
+                // the phasor never reaches `turn`, so the way back is never read.
+                simd::float_4 turn = 1.f - 0.5f * amount;
+                simd::float_4 forward = phase < turn;
+                simd::float_4 rise = 1.f / turn;
+                simd::float_4 fall = 1.f / simd::fmax(1.f - turn, 1e-6f);
+                warped = simd::ifelse(forward, phase * rise, (1.f - phase) * fall);
+                slope = simd::ifelse(forward, rise, fall);
+                break;
+            }
+        }
+        *octaves = simd::log2(slope);
+
+        // The end of the cycle is its start
+        return warped - simd::floor(warped);
+    }
+
+} // namespace Wavetable
+
+#endif
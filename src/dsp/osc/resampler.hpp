@@ -0,0 +1,116 @@
+#ifndef IGGYLABS_RESAMPLER_HPP
+#define IGGYLABS_RESAMPLER_HPP
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+
+namespace Wavetable {
+
+    // Resamples cycles of any length to a power-of-two length through their spectrum,
+    // keeping the harmonics that fit below both lengths' Nyquist.
+    //
+    // `fft` only takes powers of two. Other lengths go through Bluestein's algorithm, which
+    // turns the transform into a convolution with a chirp done with power-of-two FFTs. The
+    // chirp's transform only depends on the length, so it is worked out once per resampler
+    // and every cycle of a table then costs two FFTs to analyze and one to resynthesize.
+    struct CycleResampler {
+        int inLen;
+        int outLen;
+        int convLen = 0;  // Power of two the convolution runs at, 0 when `inLen` is a power of two
+        int harmonics;
+
+        std::vector<double> chirpRe, chirpIm;    // e^(-i pi n^2 / inLen)
+        std::vector<double> kernelRe, kernelIm;  // Transform of the conjugate chirp
+        std::vector<double> workRe, workIm;
+        std::vector<double> synthRe, synthIm;
+
+        CycleResampler(int inLen, int outLen) {
+            this->inLen = inLen;
+            this->outLen = outLen;
+            harmonics = std::min((inLen - 1) / 2, outLen / 2 - 1);
+
+            if (inLen & (inLen - 1)) {
+                convLen = 1;
+                while (convLen < 2 * inLen - 1) {
+                    convLen <<= 1;
+                }
+                chirpRe.resize(inLen);
+                chirpIm.resize(inLen);
+                for (int n = 0; n < inLen; n++) {
+                    // n^2 wraps at 2 inLen, which keeps the angle exact for long cycles
+                    double angle = M_PI * (double) (((long long) n * n) % (2 * inLen)) / inLen;
+                    chirpRe[n] = cos(angle);
+                    chirpIm[n] = -sin(angle);
+                }
+                kernelRe.assign(convLen, 0.0);
+                kernelIm.assign(convLen, 0.0);
+                for (int n = 0; n < inLen; n++) {
+                    kernelRe[n] = chirpRe[n];
+                    kernelIm[n] = -chirpIm[n];
+                    if (n > 0) {
+                        kernelRe[convLen - n] = chirpRe[n];
+                        kernelIm[convLen - n] = -chirpIm[n];
+                    }
+                }
+                fft(convLen, kernelRe.data(), kernelIm.data());
+            }
+            workRe.resize(convLen ? convLen : inLen);
+            workIm.resize(convLen ? convLen : inLen);
+            synthRe.resize(outLen);
+            synthIm.resize(outLen);
+        }
+
+        // One cycle of `inLen` samples to `outLen` samples, in playing order
+        void process(const float* in, double* out) {
+            if (!convLen) {
+                for (int n = 0; n < inLen; n++) {
+                    workRe[n] = in[n];
+                    workIm[n] = 0.0;
+                }
+                fft(inLen, workRe.data(), workIm.data());
+            } else {
+                std::fill(workRe.begin(), workRe.end(), 0.0);
+                std::fill(workIm.begin(), workIm.end(), 0.0);
+                for (int n = 0; n < inLen; n++) {
+                    workRe[n] = in[n] * chirpRe[n];
+                    workIm[n] = in[n] * chirpIm[n];
+                }
+                fft(convLen, workRe.data(), workIm.data());
+                // Multiply by the kernel and conjugate, so the forward `fft` runs the inverse
+                for (int k = 0; k < convLen; k++) {
+                    double re = workRe[k] * kernelRe[k] - workIm[k] * kernelIm[k];
+                    double im = workRe[k] * kernelIm[k] + workIm[k] * kernelRe[k];
+                    workRe[k] = re;
+                    workIm[k] = -im;
+                }
+                fft(convLen, workRe.data(), workIm.data());
+                for (int k = 0; k < inLen; k++) {
+                    double re = workRe[k] / convLen;
+                    double im = -workIm[k] / convLen;
+                    workRe[k] = re * chirpRe[k] - im * chirpIm[k];
+                    workIm[k] = re * chirpIm[k] + im * chirpRe[k];
+                }
+            }
+
+            // Harmonics into the new length's bins, conjugated for the inverse as above.
+            // DC goes, as it would when the cycle is analyzed.
+            std::fill(synthRe.begin(), synthRe.end(), 0.0);
+            std::fill(synthIm.begin(), synthIm.end(), 0.0);
+            for (int k = 1; k <= harmonics; k++) {
+                synthRe[k] = workRe[k];
+                synthIm[k] = -workIm[k];
+                synthRe[outLen - k] = workRe[inLen - k];
+                synthIm[outLen - k] = -workIm[inLen - k];
+            }
+            fft(outLen, synthRe.data(), synthIm.data());
+            for (int m = 0; m < outLen; m++) {
+                out[m] = synthRe[m] / inLen;
+            }
+        }
+    };
+
+} // namespace Wavetable
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef IGGYLABS_RETIRED_FRAMES_HPP
+#define IGGYLABS_RETIRED_FRAMES_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+
+namespace Wavetable {
+
+    // Counts the audio thread's calls into one Wavetable. It is ticked as each call starts,
+    // so once it has moved on from the count a pointer was let go at, the call that may
+    // have been reading it has finished.
+    struct AudioClock {
+        std::atomic<uint32_t> calls { 1 };
+        std::atomic<bool> stopped { false };  // Set once nothing will call in again
+
+        // Audio thread, before it loads any pointer it will read
+        void tick() {
+            calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+    // Whatever the audio thread may still be reading when it is replaced: a table's frames and
+    // pages, and anything else published to it by pointer. Each is only freed once the audio
+    // thread has moved past the call that may have loaded it, on the next worker pass after that.
+    struct RetiredFrames {
+        struct Retired {
+            std::function<void()> free;
+            std::shared_ptr<AudioClock> clock;
+            uint32_t calls;  // `clock` when it was let go
+        };
+        std::mutex mutex;
+        std::vector<Retired> retired;
+
+        ~RetiredFrames() {
+            for (Retired& r : retired) {
+                r.free();
+            }
+        }
+
+        // Any thread, once `p` can no longer be loaded by a new call
+        template <typename T>
+        void retire(T* p, const std::shared_ptr<AudioClock>& clock) {
+            if (!p) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            // The pointer is gone first, so any call that could still hold it ends by the next tick
+            retired.push_back({ [p]() { delete p; }, clock, clock->calls.load() });
+        }
+
+        // Worker: frees what the audio thread is done with
+        void collect() {
+            std::vector<Retired> done;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < retired.size();) {
+                    const Retired& r = retired[i];
+                    if (r.clock->stopped.load() || r.clock->calls.load(std::memory_order_acquire) != r.calls) {
+                        done.push_back(retired[i]);
+                        retired[i] = retired.back();
+                        retired.pop_back();
+                    } else {
+                        i++;
+                    }
+                }
+            }
+            // Freed outside the lock, since a big table takes a while to give back
+            for (Retired& r : done) {
+                r.free();
+            }
+        }
+    };
+
+    // Frames every Wavetable has let go of, freed on the worker's passes
+    static RetiredFrames retiredFrames;
+
+} // namespace Wavetable
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef IGGYLABS_SPECTRAL_HPP
+#define IGGYLABS_SPECTRAL_HPP
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace Wavetable {
+
+    // Harmonic magnitudes and phases of one frame, cached at load time so frames can be
+    // morphed in the frequency domain without re-analyzing them.
+    //
+    // Bins follow the earlevel convention (samples go in the imaginary part of the forward
+    // FFT), so bin N - k is always -conj(bin k) and only harmonics 1..N/2 - 1 are kept.
+    // Magnitudes already include the frame's normalization.
+    struct FrameSpectrum {
+        int length = 0;       // Cycle length, i.e. FFT size
+        int maxHarmonic = 0;  // Highest non-zero harmonic
+        std::vector<float> magnitude;
+        std::vector<float> phase;
+
+        size_t bytes() const {
+            return (magnitude.capacity() + phase.capacity()) * sizeof(float);
+        }
+
+        // Takes the FFT of one cycle (earlevel layout, modified in place), finds its highest
+        // harmonic and normalizes it the way earlevel's makeWaveTable did: full-band peak at 0.999
+        void analyze(double* freqWaveRe, double* freqWaveIm, int len) {
+            // zero DC offset and Nyquist
+            freqWaveRe[0] = freqWaveIm[0] = 0.0;
+            freqWaveRe[len >> 1] = freqWaveIm[len >> 1] = 0.0;
+
+            length = len;
+            maxHarmonic = len >> 1;
+            const double minVal = 0.000001; // -120 dB
+            while ((fabs(freqWaveRe[maxHarmonic]) + fabs(freqWaveIm[maxHarmonic]) < minVal) && maxHarmonic) --maxHarmonic;
+
+            // Full-band resynthesis gives the peak to normalize by
+            std::vector<double> ar(len, 0.0), ai(len, 0.0);
+            for (int k = 1; k <= maxHarmonic; k++) {
+                ar[k] = freqWaveRe[k];
+                ai[k] = freqWaveIm[k];
+                ar[len - k] = freqWaveRe[len - k];
+                ai[len - k] = freqWaveIm[len - k];
+            }
+            fft(len, ar.data(), ai.data());
+            double max = 0.0;
+            for (int idx = 0; idx < len; idx++) {
+                max = std::max(max, fabs(ai[idx]));
+            }
+            double scale = max > 0.0 ? 1.0 / max * .999 : 0.0;
+
+            magnitude.assign(len >> 1, 0.f);
+            phase.assign(len >> 1, 0.f);
+            for (int k = 1; k <= maxHarmonic; k++) {
+                magnitude[k] = hypot(freqWaveRe[k], freqWaveIm[k]) * scale;
+                phase[k] = atan2(freqWaveIm[k], freqWaveRe[k]);
+            }
+        }
+    };
+
+    // Fills `ar`/`ai` (a.length bins) with the spectrum `frac` of the way from `a` to `b`,
+    // keeping harmonics up to `harmonics`, by interpolating magnitudes and taking the short
+    // way round for phases. A `tilt` scales harmonic k by k^-tilt, 6 dB/octave per unit.
+    inline void morphSpectrum(const FrameSpectrum& a, const FrameSpectrum& b, float frac, int harmonics,
+                              double* ar, double* ai, float tilt = 0.f) {
+        int len = a.length;
+        for (int idx = 0; idx < len; idx++) {
+            ar[idx] = ai[idx] = 0.0;
+        }
+
+        harmonics = std::min(harmonics, (len >> 1) - 1);
+        for (int k = 1; k <= harmonics; k++) {
+            float dPhase = b.phase[k] - a.phase[k];
+            dPhase -= 2.f * M_PI * roundf(dPhase / (2.f * M_PI));
+
+            double mag = a.magnitude[k] + frac * (b.magnitude[k] - a.magnitude[k]);
+            if (tilt != 0.f) {
+                mag *= pow(k, -tilt);
+            }
+            double ph = a.phase[k] + frac * dPhase;
+            ar[k] = mag * cos(ph);
+            ai[k] = mag * sin(ph);
+            ar[len - k] = -ar[k];
+            ai[len - k] = ai[k];
+        }
+    }
+
+    // Resynthesizes the morphed frame described above. `ar` and `ai` are scratch buffers of
+    // at least `a.length` samples; `out` receives a.length + 1 samples including the
+    // wraparound sample.
+    inline void morphSpectra(const FrameSpectrum& a, const FrameSpectrum& b, float frac, int harmonics,
+                             double* ar, double* ai, float* out, float tilt = 0.f) {
+        int len = a.length;
+        morphSpectrum(a, b, frac, harmonics, ar, ai, tilt);
+        fft(len, ar, ai);
+        for (int idx = 0; idx < len; idx++) {
+            out[idx] = ai[idx];
+        }
+        out[len] = out[0];
+    }
+
+} // namespace Wavetable
+
+#endif
@@ -1,18 +1,77 @@
 // Plugins for VCV Rack by iggy.labs
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include <sys/stat.h>
 #define DR_WAV_IMPLEMENTATION
 #include "../../../lib/dr_wav.h"
-#include "../../dsp/osc/earlevel/WaveUtils.cpp"
+#include "../../dsp/osc/earlevel/fft.cpp"
 
 #define BASE_FREQUENCY 20    // Starting frequency of the first table, 20Hz
-#define MAX_CYCLE_COUNT 256
+#define MAX_CYCLE_COUNT 256  // Longer tables are paged
 #define MAX_CYCLE_LENGTH 2048
+#define MAX_SOURCE_LENGTH 65536  // Longest cycle a file can have, before it is resampled
+#define MAX_PITCH 3.5f       // Voices play within ±3.5 V of C4
+#define CAPTURE_FRAMES 64    // Frames in the live capture ring
+#define WATCH_INTERVAL_MS 250  // How often the loaded file is checked for changes
+#define MAX_TABLES 16        // Tables in a bank
+#define MAX_TILT 2.f         // Tilt at the lowest brightness: harmonics roll off by 12 dB/octave
+#define REBUILD_FADE 1024    // Samples over which voices crossfade to a table rebuilt for a new brightness
+#define RESET_FADE 64        // Samples over which a voice crossfades from where it was when its phase is reset
+#define UNDO_BUDGET_MB 256   // Memory every Table's undo history can keep built tables in
+
+#include "morph-cache.hpp"
+#include "spectral.hpp"
+#include "resampler.hpp"
+#include "frame-storage.hpp"
+#include "paged-frames.hpp"
+#include "retired-frames.hpp"
+#include "worker.hpp"
+#include "cycle-detect.hpp"
+#include "phase-warp.hpp"
+#include "embedded-frames.hpp"
 
 
 namespace Wavetable {
 
     static std::vector<int> cycleLengths { 256, 512, 1024, 2048 };
+    static std::vector<int> upsampleCounts { 64, 256 };
+
+    // When a file was last written and how big it is, to tell when it changes on disk
+    struct FileStamp {
+        int64_t seconds = 0;
+        int64_t nanos = 0;
+        int64_t size = -1;  // -1 if there is no such file
+
+        bool operator==(const FileStamp& other) const {
+            return seconds == other.seconds && nanos == other.nanos && size == other.size;
+        }
+
+        bool operator!=(const FileStamp& other) const {
+            return !(*this == other);
+        }
+
+        static FileStamp of(const std::string& path) {
+            FileStamp stamp;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) {
+                return stamp;
+            }
+            stamp.seconds = st.st_mtime;
+            stamp.size = st.st_size;
+            // Sub-second times where the platform has them, so quick saves are not missed
+#if defined ARCH_LIN
+            stamp.nanos = st.st_mtim.tv_nsec;
+#elif defined ARCH_MAC
+            stamp.nanos = st.st_mtimespec.tv_nsec;
+#endif
+            return stamp;
+        }
+    };
 
     struct Wavetable {
 
@@ -24,53 +83,1052 @@ namespace Wavetable {
         };
 
         std::string lastPath;
-        std::array<std::array<double, MAX_CYCLE_LENGTH>, MAX_CYCLE_COUNT> cycleBuffers;
+        bool embed = false;        // Keep the loaded file's cycles in `embedded`, applied on the next load
+        EmbeddedFrames embedded;   // To save in the patch, so the table can be rebuilt without the file
 
-        int cycleLength;
+        int cycleLength;       // Samples per cycle in the table, a power of two
+        int sourceLength;      // Samples per cycle in the file, resampled to `cycleLength`
         int numCycles;
+        int sourceCycles = 1;  // Cycles read from the file, before upsampling
+        int lengthSource = CHOSEN_LENGTH;  // Where `sourceLength` came from
+        float detectMillis = 0.f;          // Time taken to work out the cycle length
+
+        // Stereo tables hold the left side's frames followed by the right side's, `numCycles`
+        // each. Other tables are one side, with multichannel files mixed down to it.
+        bool stereo = false;   // Split stereo files into two sides, applied on the next load
+        int numChannels = 1;
+
+        // A bank holds several tables end to end in `storage`, and each voice picks one, or
+        // morphs between two neighbouring ones. `numCycles` is then the first table's; the
+        // rest start at `tableFirst`.
+        struct BankEntry {
+            std::string path;
+            int cycleLength;  // Samples per cycle in the file, or DETECT_CYCLE_LENGTH
+        };
+        std::vector<BankEntry> bank;  // The files of a bank of more than one table
+        int numTables = 1;
+        std::array<int, MAX_TABLES> tableFirst;   // First frame of each table
+        std::array<int, MAX_TABLES> tableCycles;  // Frames in each table
+        bool tableMorph = true;  // Blend between tables, rather than stepping from one to the next
+
+        // Load-time frame upsampling: synthesize `upsampleCount` frames across short tables
+        // so playback can pick the nearest frame instead of morphing between distant ones
+        int upsampleCount = 0;  // 0 is off
+        int upsampleMode = LINEAR_MORPH;
+        bool nearestFrame = true;
+
+        size_t tableBytes = 0;     // Memory held by the built frames and their spectra
+        size_t upsampleBytes = 0;  // Part of `tableBytes` that is due to upsampling
+        size_t sharedBytes = 0;    // Saved by storing repeated tables once
+        int uniqueTables = 0;
+        int totalTables = 0;       // One per mip level per frame
 
-        bool loading = false;
+        std::atomic<bool> loading { false };
         bool loaded = false;
 
-        std::array<double, 16> phasors;    // phase accumulator
-        std::array<double, 16> phaseIncs;  // phase increment, aka normalized frequency
+        // Voices are processed four at a time, one SIMD lane each
+        std::array<simd::float_4, 4> phasors;    // phase accumulator, over two cycles for the sub octave
+        std::array<simd::float_4, 4> phaseIncs;  // phase increment, aka normalized frequency
+        std::array<simd::float_4, 4> incPitches; // pitch the increment was worked out for
+        float incSampleRate = 0.f;
+        uint32_t incChannels = 0;                // bit per channel whose `incPitches` is current
 
-        // To create multiple positions for a 2D wavetable voice, 
-        // make a single WaveTableOsc for each possible cycle.
-        std::vector<WaveTableOsc*> wavetableOscillators;
+        // A voice whose phase is reset keeps its old phasor running for RESET_FADE samples,
+        // and crossfades from it to the new one
+        std::array<simd::float_4, 4> resetPhasors;
+        std::array<simd::float_4, 4> resetFades;  // Samples of the crossfade left
+        uint32_t resetChannels = 0;               // Bit per channel still crossfading
 
-        Wavetable() {
-            wavetableOscillators.push_back(sawOsc());
+        // Every cycle's bandlimited tables, in one block. For a table of more than
+        // MAX_CYCLE_COUNT cycles, this is the preview that stands in for frames whose page
+        // is not built yet, and the frames themselves are in `pages`. Captured and edited
+        // frames are also published as pages, over the frames in `storage`.
+        std::atomic<FrameStorage*> storage { nullptr };
+        std::atomic<FramePages*> pages { nullptr };
+        std::vector<FrameSpectrum> spectra;  // One per frame, for spectral morphing
+
+        // Ticked by the audio thread as each call starts. Frames it may be reading are handed
+        // to `retiredFrames` when they are replaced, rather than freed.
+        std::shared_ptr<AudioClock> audioClock = std::make_shared<AudioClock>();
+
+        int morphMode = LINEAR_MORPH;
+        int warpMode = NO_WARP;
+
+        // Brightness is rendered into the tables, as a tilt of every harmonic's level (see
+        // morphSpectrum), so it costs the voices nothing. A new brightness has the worker
+        // rebuild the table, and the voices then crossfade to it from the table before.
+        std::atomic<float> tilt { 0.f };
+        std::atomic<FrameStorage*> fadeFrom { nullptr };  // Retired by the worker once faded out
+        std::atomic<int> fadeRemaining { 0 };             // Samples of the crossfade left, counted down by tick()
+        std::atomic<int> storageFormat { FLOAT_STORAGE };  // Applied on the next load or rebuild
+
+        // Engine rate the mip levels are built for; levels that cannot be reached are skipped
+        float sampleRate = 44100.f;
+        std::atomic<bool> rebuildRequested { false };
+
+        // Guards `storage`, `pages` and `spectra` between the loader and the worker.
+        // The audio thread does not take it; it relies on `loading` and `generation`.
+        std::mutex tableMutex;
+        std::atomic<int> generation { 0 };  // Bumped on every (re)load to invalidate bakes
+
+        std::array<MorphCache, 2 * 2 * 16> morphCaches;  // Per table of a bank morph, per side, per voice
+
+        // Worker-only scratch for baking
+        std::array<double, MAX_CYCLE_LENGTH> resynthRe;
+        std::array<double, MAX_CYCLE_LENGTH> resynthIm;
+        std::array<float, MAX_CYCLE_LENGTH + 1> bakeBelow;
+        std::array<float, MAX_CYCLE_LENGTH + 1> bakeAbove;
+
+        // Resynthesis throughput, measured on the worker
+        std::atomic<float> resynthMicros { 0.f };  // Smoothed time per resynthesized frame
+        std::atomic<int> resynthCount { 0 };
+
+        // Live capture: the input is cut into cycles written round a ring of CAPTURE_FRAMES
+        // raw frames. The worker rebuilds each frame as it completes and publishes it as its
+        // own page. Each raw frame is a seqlock: its count is odd while the audio thread is
+        // writing it, so the worker can tell a torn copy and leave it for the next pass.
+        // Every capture starts a new ring, and the one it replaces is retired, so the audio
+        // thread is never left writing into a ring as it goes.
+        struct CaptureRing {
+            int length;
+            std::vector<float> samples;
+            std::array<std::atomic<uint32_t>, CAPTURE_FRAMES> seqs;
+            std::array<std::chrono::steady_clock::time_point, CAPTURE_FRAMES> capturedAt;
+            int frame = 0;  // Audio thread: frame and sample being written
+            int index = 0;
+            std::array<uint32_t, CAPTURE_FRAMES> builtSeqs;  // Worker: last count built per frame
+            std::vector<double> cycle;
+
+            CaptureRing(int length) {
+                this->length = length;
+                samples.assign((size_t) CAPTURE_FRAMES * length, 0.f);
+                cycle.assign(length, 0.0);
+                for (int f = 0; f < CAPTURE_FRAMES; f++) {
+                    seqs[f].store(0);
+                    builtSeqs[f] = 0;
+                }
+            }
+        };
+        std::atomic<bool> capturing { false };
+        int captureLength = 0;
+        std::atomic<CaptureRing*> captureRing { nullptr };  // Swapped under `tableMutex`
+
+        // Time from a cycle's last sample arriving to it being playable, measured on the worker
+        std::atomic<float> captureLatencyMicros { 0.f };
+        std::atomic<int> captureCount { 0 };
 
+        // Frame edits from the editor, waiting for the worker. Later edits of a frame replace
+        // earlier ones, so the worker only ever rebuilds the latest drawing.
+        struct FrameEdit {
+            int frame;
+            std::vector<float> samples;  // One cycle, in playing order
+        };
+        std::mutex editMutex;
+        std::vector<FrameEdit> pendingEdits;
+        bool fullBand = false;  // Build every mip level a cycle can have, so edits are not cut off
+
+        // Time to rebuild one edited frame, measured on the worker
+        std::atomic<float> editMicros { 0.f };
+        std::atomic<int> editCount { 0 };
+
+        // A patch's embedded cycles, waiting for the worker to rebuild the table from them.
+        // `restoreMutex` is held for the whole rebuild, so a load from the UI drops a restore
+        // that hasn't started, and waits for one that has, rather than running beside it.
+        struct EmbeddedRestore {
+            EmbeddedFrames frames;
+            std::string path;
+            int cycleLength;
+        };
+        std::mutex restoreMutex;
+        std::unique_ptr<EmbeddedRestore> pendingRestore;
+
+        // Hot reload: the worker checks the loaded file every WATCH_INTERVAL_MS. Cycles whose
+        // samples changed are rebuilt on their own, like edits; a file that no longer has
+        // the same cycles is handed back to the UI thread (`reloadRequested`) to load again.
+        std::atomic<bool> reloadOnChange { true };
+        std::atomic<bool> reloadRequested { false };
+        struct WatchedFile {
+            std::string path;
+            FileStamp stamp;               // The file as it was last read
+            int sourceLength = 0;          // Samples per cycle in the file
+            int fileChannels = 0;          // Channels in the file
+            int tableChannels = 1;         // Sides of the table they were split into
+            std::vector<uint64_t> hashes;  // One per frame, empty if frames don't map to cycles
+        };
+        WatchedFile watched;  // Guarded by `tableMutex`
+        std::chrono::steady_clock::time_point lastCheck;  // Worker only
+        FileStamp settlingStamp;
+
+        // Frames rebuilt by the last reload, measured on the worker
+        std::atomic<int> reloadedFrames { 0 };
+        std::atomic<float> reloadMillis { 0.f };
+
+        // A table taken out of use whole, frames and all, so that undo can put it back without
+        // building it again. The frames can be let go to save memory (see SnapshotBudget),
+        // leaving what to load again instead.
+        struct Snapshot {
+            std::string path;
+            std::vector<BankEntry> bank;
+            int captureLength = 0;  // Of a live capture, which is only ever started afresh
+            int cycleLength = MAX_CYCLE_LENGTH;
+            int sourceLength = MAX_CYCLE_LENGTH;
+            int numCycles = 1;
+            int sourceCycles = 1;
+            int lengthSource = CHOSEN_LENGTH;
+            float detectMillis = 0.f;
+            int numChannels = 1;
+            int numTables = 1;
+            std::array<int, MAX_TABLES> tableFirst;
+            std::array<int, MAX_TABLES> tableCycles;
+            bool fullBand = false;
+            float tilt = 0.f;  // Brightness the frames were built at
+            EmbeddedFrames embedded;
+            WatchedFile watched;
+
+            // nullptr once let go
+            FrameStorage* storage = nullptr;
+            FramePages* pages = nullptr;
+            std::vector<FrameSpectrum> spectra;
+            std::shared_ptr<AudioClock> clock;  // Of the Wavetable the frames were taken from
+
+            ~Snapshot() {
+                release();
+            }
+
+            bool built() const {
+                return storage != nullptr;
+            }
+
+            size_t bytes() const {
+                if (!storage) {
+                    return 0;
+                }
+                size_t bytes = storage->bytes + (pages ? pages->residentBytes.load() : 0);
+                for (const FrameSpectrum& spectrum : spectra) {
+                    bytes += spectrum.bytes();
+                }
+                return bytes;
+            }
+
+            // The audio thread may still be reading frames that were only just taken out of use
+            void release() {
+                if (storage) {
+                    retiredFrames.retire(storage, clock);
+                    retiredFrames.retire(pages, clock);
+                }
+                storage = nullptr;
+                pages = nullptr;
+                std::vector<FrameSpectrum>().swap(spectra);
+            }
+        };
+        std::shared_ptr<Snapshot> retiring;  // Given the frames swapStorage replaces, instead of them being freed
+
+        uint32_t workerCalls = 0;  // Worker: `audioClock` at its last pass
+
+        Wavetable() {
             lastPath = "";
             cycleLength = MAX_CYCLE_LENGTH;
+            sourceLength = MAX_CYCLE_LENGTH;
             numCycles = 1;
+            buildSaw();
             loading = false;
             loaded = false;
 
-            phasors.fill(0.f);
-            phaseIncs.fill(0.f);
+            phasors.fill(simd::float_4::zero());
+            phaseIncs.fill(simd::float_4::zero());
+            incChannels = 0;
+            resetChannels = 0;
+
+            worker.add(this, [this]() {
+                bool worked = restoreEmbedded();
+                rebuildStorage();
+                applyEdits();
+                checkFile();
+                worked |= pageFrames();
+                captureFrames();
+                worked |= bakeMorphCaches();
+                return busy(worked);
+            });
+        }
+
+        ~Wavetable() {
+            worker.remove(this);
+            audioClock->stopped = true;
+            delete fadeFrom.load();
+            delete storage.load();
+            delete pages.load();
+            delete captureRing.load();
+        }
+
+        // The default table: a single sawtooth, built from its spectrum
+        void buildSaw() {
+            int tableLen = 2048;    // to give full bandwidth from 20 Hz
+            std::vector<double> freqWaveRe(tableLen, 0.0), freqWaveIm(tableLen, 0.0);
+            for (int idx = 1; idx < (tableLen >> 1); idx++) {
+                freqWaveRe[idx] = 1.0 / idx;                    // sawtooth spectrum
+                freqWaveRe[tableLen - idx] = -freqWaveRe[idx];  // mirror
+            }
+
+            std::vector<FrameSpectrum> sawSpectra(1);
+            sawSpectra[0].analyze(freqWaveRe.data(), freqWaveIm.data(), tableLen);
+            swapStorage(buildStorage(sawSpectra, tableLen, FLOAT_STORAGE), sawSpectra);
+            measureTables();
+        }
+
+        // Highest normalized frequency a voice can read the table at, at the current rate,
+        // including how much faster a phase warp can read it
+        double maxFreqNormal() const {
+            return dsp::FREQ_C4 * pow(2.0, MAX_PITCH + MAX_WARP_OCTAVES) / sampleRate;
+        }
+
+        FrameStorage* buildStorage(const std::vector<FrameSpectrum>& frameSpectra, int len, int format) {
+            FrameStorage* frames = buildFrameStorage(frameSpectra.data(), frameSpectra.size(), len, format, maxFreqNormal(),
+                                                     fullBand ? len / 2 - 1 : 0, tilt, true);
+            if (frames) {
+                frames->setSampleRate(sampleRate);
+            }
+            return frames;
+        }
+
+        // The first frame of every page, with the whole table's mip levels
+        FrameStorage* buildPreview(const std::vector<FrameSpectrum>& frameSpectra, int len, int format) {
+            std::vector<FrameSpectrum> firstFrames;
+            int maxHarmonic = 0;
+            for (int frame = 0; frame < (int) frameSpectra.size(); frame++) {
+                if (frame % FRAMES_PER_PAGE == 0) {
+                    firstFrames.push_back(frameSpectra[frame]);
+                }
+                maxHarmonic = std::max(maxHarmonic, frameSpectra[frame].maxHarmonic);
+            }
+            if (fullBand) {
+                maxHarmonic = len / 2 - 1;
+            }
+            FrameStorage* frames = buildFrameStorage(firstFrames.data(), firstFrames.size(), len, format, maxFreqNormal(), maxHarmonic, tilt, true);
+            if (frames) {
+                frames->setSampleRate(sampleRate);
+            }
+            return frames;
+        }
+
+        // Called from the engine between process() calls. The level boundaries move right away;
+        // if the rate needs a different set of levels, the worker rebuilds them from the cached spectra.
+        void setSampleRate(float rate) {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            sampleRate = rate;
+            FrameStorage* frames = storage;
+            if (!frames) {
+                return;
+            }
+            frames->setSampleRate(rate);
+            if (FrameStorage::mipLevels(frames->maxHarmonic, maxFreqNormal()) != frames->numMips) {
+                rebuildRequested = true;
+                worker.notify();
+            }
+        }
+
+        // From 0, where harmonics roll off by 12 dB/octave, to 1, the table as loaded. The
+        // worker rebuilds the table at the next pass.
+        void setBrightness(float brightness) {
+            float newTilt = (1.f - brightness) * MAX_TILT;
+            if (newTilt != tilt.load(std::memory_order_relaxed)) {
+                tilt.store(newTilt);
+                rebuildRequested = true;
+            }
+        }
+
+        // Runs on the worker
+        void rebuildStorage() {
+            // Rebuilds wait for the voices to fade out of the table before the last one
+            FrameStorage* faded = fadeFrom.load();
+            if (faded) {
+                if (fadeRemaining.load(std::memory_order_acquire) > 0) {
+                    return;
+                }
+                fadeFrom = nullptr;
+                retiredFrames.retire(faded, audioClock);
+            }
+            if (!rebuildRequested.exchange(false)) {
+                return;
+            }
+
+            FrameStorage* old;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                FramePages* framePages = pages;
+                const FrameStorage* current = storage;
+                FrameStorage* frames;
+                // In the chosen format, which a table kept as float for its noise may now meet
+                if (capturing) {
+                    frames = buildCapturePreview(current->cycleLength, storageFormat);
+                } else if (framePages && framePages->paged) {
+                    frames = buildPreview(spectra, current->cycleLength, storageFormat);
+                } else {
+                    frames = buildStorage(spectra, current->cycleLength, storageFormat);
+                }
+                if (!frames) {
+                    // Out of memory: the table stays as it was
+                    return;
+                }
+                frames->counts = current->counts;
+                if (framePages) {
+                    // Pages are built against the preview's levels. Edited frames are in
+                    // `spectra`, so the new table already has them.
+                    framePages->evictAll();
+                }
+                loading = true;
+                old = storage;
+                storage = frames;
+                generation++;
+                if (!framePages) {
+                    // Pages are laid over one table at a time, so only a plain table fades
+                    fadeFrom = old;
+                    fadeRemaining.store(REBUILD_FADE, std::memory_order_release);
+                    old = nullptr;
+                }
+                loading = false;
+
+                CaptureRing* ring = captureRing;
+                if (capturing && ring) {
+                    for (int frame = 0; frame < CAPTURE_FRAMES; frame++) {
+                        if (ring->builtSeqs[frame] != 0) {
+                            publishCaptured(frame);
+                        }
+                    }
+                }
+            }
+            retiredFrames.retire(old, audioClock);
+            measureTables();
+        }
+
+        // Runs on the worker: keeps the pages voices are reading bandlimited. Returns whether
+        // any are being read.
+        bool pageFrames() {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            FramePages* framePages = pages;
+            if (!framePages || !framePages->paged) {
+                return false;
+            }
+            const FrameStorage* preview = storage;
+            return framePages->update([this, preview](int first, int count) {
+                return buildFrameStorage(&spectra[first], count, preview->cycleLength, preview->format,
+                                         maxFreqNormal(), preview->maxHarmonic, tilt);
+            });
+        }
+
+        // Starts capturing `cl`-sample cycles into a ring of silent frames, replacing the table.
+        // The mip levels cover a full-band cycle, since any cycle may come in.
+        void startCapture(int cl) {
+            // Out of memory: the table stays as it was
+            FrameStorage* preview = buildCapturePreview(cl, storageFormat);
+            if (!preview) {
+                return;
+            }
+
+            loading = true;
+            capturing = false;
+
+            this->cycleLength = cl;
+            this->numCycles = CAPTURE_FRAMES;
+            this->sourceCycles = CAPTURE_FRAMES;
+            this->numChannels = 1;
+            this->numTables = 1;
+            captureLength = cl;
+            CaptureRing* old;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                old = captureRing.exchange(new CaptureRing(cl));
+            }
+            retiredFrames.retire(old, audioClock);
+            captureCount = 0;
+
+            std::vector<FrameSpectrum> frameSpectra = silentSpectra(cl);
+            FramePages* framePages = new FramePages(CAPTURE_FRAMES, 1);
+            framePages->paged = false;
+            stampCounts(preview);
+            swapStorage(preview, frameSpectra, framePages);
+            measureTables();
+
+            capturing = true;
+            loading = false;
+            loaded = true;
+        }
+
+        static std::vector<FrameSpectrum> silentSpectra(int len) {
+            std::vector<double> silence(len, 0.0);
+            std::vector<FrameSpectrum> frameSpectra(CAPTURE_FRAMES);
+            analyzeCycle(silence.data(), len, &frameSpectra[0]);
+            for (int frame = 1; frame < CAPTURE_FRAMES; frame++) {
+                frameSpectra[frame] = frameSpectra[0];
+            }
+            return frameSpectra;
+        }
+
+        FrameStorage* buildCapturePreview(int len, int format) {
+            std::vector<FrameSpectrum> frameSpectra = silentSpectra(len);
+            FrameStorage* frames = buildFrameStorage(frameSpectra.data(), CAPTURE_FRAMES, len, format, maxFreqNormal(), len / 2 - 1, 0.f, true);
+            if (frames) {
+                frames->setSampleRate(sampleRate);
+            }
+            return frames;
+        }
+
+        // Audio thread: one sample of the capture input
+        void capture(float in) {
+            if (!capturing.load(std::memory_order_acquire)) {
+                return;
+            }
+            CaptureRing* ring = captureRing.load(std::memory_order_acquire);
+            std::atomic<uint32_t>& seq = ring->seqs[ring->frame];
+            if (ring->index == 0) {
+                seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+            ring->samples[ring->frame * ring->length + ring->index] = in;
+            if (++ring->index == ring->length) {
+                ring->capturedAt[ring->frame] = std::chrono::steady_clock::now();
+                seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                ring->index = 0;
+                ring->frame = (ring->frame + 1) % CAPTURE_FRAMES;
+            }
+        }
+
+        // Runs on the worker: analyzes and publishes every frame captured since the last pass
+        void captureFrames() {
+            if (!capturing) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(tableMutex);
+            CaptureRing* ring = captureRing;
+            if (!pages.load() || !ring || !capturing) {
+                return;
+            }
+            pages.load()->collect();
+
+            bool published = false;
+            int len = ring->length;
+            for (int frame = 0; frame < CAPTURE_FRAMES; frame++) {
+                uint32_t seq = ring->seqs[frame].load(std::memory_order_acquire);
+                if ((seq & 1) || seq == ring->builtSeqs[frame]) {
+                    continue;
+                }
+                std::chrono::steady_clock::time_point completed = ring->capturedAt[frame];
+                for (int n = 0; n < len; n++) {
+                    // Reversed like a loaded cycle, see loadWavetable
+                    ring->cycle[(len - n) % len] = ring->samples[frame * len + n];
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (ring->seqs[frame].load(std::memory_order_relaxed) != seq) {
+                    // Overwritten while copying; the newer cycle is picked up when it completes
+                    continue;
+                }
+
+                analyzeCycle(ring->cycle.data(), len, &spectra[frame]);
+                publishCaptured(frame);
+                ring->builtSeqs[frame] = seq;
+                published = true;
+
+                std::chrono::duration<float, std::micro> latency = std::chrono::steady_clock::now() - completed;
+                float micros = captureLatencyMicros.load();
+                captureLatencyMicros.store(captureCount++ == 0 ? latency.count() : micros + (latency.count() - micros) / 16.f);
+            }
+
+            if (published) {
+                // Bakes of the old frames are stale
+                generation++;
+            }
+        }
+
+        void publishCaptured(int frame) {
+            const FrameStorage* preview = storage;
+            pages.load()->publish(frame, buildFrameStorage(&spectra[frame], 1, preview->cycleLength, preview->format,
+                                                           maxFreqNormal(), preview->maxHarmonic, tilt));
+        }
+
+        // The frame as the editor draws it: one full-band cycle, in playing order
+        std::vector<float> frameSamples(int frame) {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            frame = clamp(frame, 0, (int) spectra.size() - 1);
+            const FrameSpectrum& spectrum = spectra[frame];
+            std::vector<double> ar(spectrum.length), ai(spectrum.length);
+            std::vector<float> samples(spectrum.length + 1);
+            morphSpectra(spectrum, spectrum, 0.f, spectrum.maxHarmonic, ar.data(), ai.data(), samples.data());
+            samples.pop_back();
+            return samples;
+        }
+
+        // Editor opened: make sure edits can use every harmonic the cycle length allows.
+        // A table built with fewer levels is rebuilt once on the worker.
+        void prepareEditing() {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            fullBand = true;
+            const FrameStorage* frames = storage;
+            if (frames->maxHarmonic < frames->cycleLength / 2 - 1) {
+                rebuildRequested = true;
+                worker.notify();
+            }
+        }
+
+        // UI thread: queue a redrawn frame for the worker
+        void editFrame(int frame, const std::vector<float>& samples) {
+            {
+                std::lock_guard<std::mutex> lock(editMutex);
+                auto edit = std::find_if(pendingEdits.begin(), pendingEdits.end(), [frame](const FrameEdit& e) { return e.frame == frame; });
+                if (edit != pendingEdits.end()) {
+                    edit->samples = samples;
+                } else {
+                    pendingEdits.push_back({ frame, samples });
+                }
+            }
+            worker.notify();
+        }
+
+        // Runs on the worker: re-analyzes each edited frame and rebuilds only its mip levels,
+        // which are published as the frame's page. Nothing else in the table is touched.
+        void applyEdits() {
+            std::vector<FrameEdit> edits;
+            {
+                std::lock_guard<std::mutex> lock(editMutex);
+                edits.swap(pendingEdits);
+            }
+            if (edits.empty()) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(tableMutex);
+            int len = storage.load()->cycleLength;
+            std::vector<double> cycle(len);
+            for (const FrameEdit& edit : edits) {
+                if (edit.frame < 0 || edit.frame >= (int) spectra.size() || (int) edit.samples.size() != len) {
+                    // Drawn on a table that has since been replaced
+                    continue;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                for (int n = 0; n < len; n++) {
+                    // Reversed like a loaded cycle, see loadWavetable
+                    cycle[(len - n) % len] = edit.samples[n];
+                }
+                analyzeCycle(cycle.data(), len, &spectra[edit.frame]);
+                publishFrame(edit.frame);
+
+                std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                float micros = editMicros.load();
+                editMicros.store(editCount++ == 0 ? elapsed.count() : micros + (elapsed.count() - micros) / 16.f);
+            }
+
+            // Bakes of the old frames are stale
+            generation++;
+        }
+
+        // Rebuilds one frame from its spectrum and lays it over the table, leaving every other
+        // frame as it is. The caller holds `tableMutex` and bumps `generation`.
+        void publishFrame(int frame) {
+            const FrameStorage* frames = storage;
+            int len = frames->cycleLength;
+            FramePages* framePages = pages;
+            if (!framePages) {
+                // The first changed frame lays one-frame pages over the table, which stays in
+                // place underneath for every frame that has not changed
+                framePages = new FramePages(spectra.size(), 1);
+                framePages->paged = false;
+                pages.store(framePages, std::memory_order_release);
+            }
+            framePages->collect();
+            if (!framePages->paged) {
+                framePages->publish(frame, buildFrameStorage(&spectra[frame], 1, len, frames->format,
+                                                             maxFreqNormal(), frames->maxHarmonic, tilt));
+            } else if (framePages->resident(frame)) {
+                // A paged table rebuilds the page; otherwise the change is in `spectra` for
+                // when the page comes in
+                int page = frame / framePages->framesPerPage;
+                int first = framePages->firstFrame(page);
+                framePages->publish(page, buildFrameStorage(&spectra[first], framePages->framesIn(page), len, frames->format,
+                                                            maxFreqNormal(), frames->maxHarmonic, tilt));
+            }
+        }
+
+        // Runs on the worker: reloads the table's file once it has changed and settled
+        void checkFile() {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (!reloadOnChange || capturing || now - lastCheck < std::chrono::milliseconds(WATCH_INTERVAL_MS)) {
+                return;
+            }
+            lastCheck = now;
+
+            std::string path;
+            FileStamp loaded;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                path = watched.path;
+                loaded = watched.stamp;
+            }
+            if (path.empty()) {
+                return;
+            }
+
+            // Editors can take a while to write a file out, so wait until it is the same
+            // on two checks in a row
+            FileStamp stamp = FileStamp::of(path);
+            bool settled = stamp == settlingStamp;
+            settlingStamp = stamp;
+            if (stamp.size < 0 || stamp == loaded || !settled) {
+                return;
+            }
+            reloadChangedFrames(path, stamp);
+        }
+
+        // Runs on the worker: re-reads the file and rebuilds just the cycles that differ
+        void reloadChangedFrames(const std::string& path, const FileStamp& stamp) {
+            auto start = std::chrono::steady_clock::now();
+
+            std::vector<uint64_t> hashes;
+            int sourceLen;
+            int fileChannels;
+            int sides;
+            int len;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                if (path != watched.path) {
+                    // Another table was loaded meanwhile
+                    return;
+                }
+                // Not tried again until the file changes again
+                watched.stamp = stamp;
+                hashes = watched.hashes;
+                sourceLen = watched.sourceLength;
+                fileChannels = watched.fileChannels;
+                sides = watched.tableChannels;
+                len = storage.load()->cycleLength;
+            }
+            if (hashes.empty()) {
+                // Frames are upsampled from the cycles, or come from a folder of files
+                reloadRequested = true;
+                return;
+            }
+
+            unsigned int channels;
+            unsigned int fileSampleRate;
+            drwav_uint64 totalSampleCount;
+            float* sampleData = drwav_open_and_read_file_f32(path.c_str(), &channels, &fileSampleRate, &totalSampleCount);
+            if (sampleData == NULL) {
+                return;
+            }
+
+            int monoSampleCount = totalSampleCount / channels;
+            int cycles = hashes.size() / sides;
+            if ((int) channels != fileChannels || monoSampleCount < sourceLen || monoSampleCount / sourceLen != cycles) {
+                // Cycles or channels were added or removed
+                drwav_free(sampleData);
+                reloadRequested = true;
+                return;
+            }
+            std::vector<std::vector<float>> sideSamples = splitChannels(sampleData, monoSampleCount, channels, sides);
+            drwav_free(sampleData);
+
+            // Analyze the cycles that changed, split and resampled like in loadWavetable
+            std::vector<int> changed;
+            std::vector<FrameSpectrum> changedSpectra;
+            CycleResampler resampler(sourceLen, len);
+            std::vector<double> samples(len);
+            std::vector<double> cycle(len);
+            for (int side = 0; side < sides; side++) {
+                for (int c = 0; c < cycles; c++) {
+                    int frame = side * cycles + c;
+                    const float* source = sideSamples[side].data() + c * sourceLen;
+                    uint64_t hash = hashCycle(source, sourceLen);
+                    if (hash == hashes[frame]) {
+                        continue;
+                    }
+                    hashes[frame] = hash;
+                    readCycle(source, resampler, samples, cycle);
+                    changed.push_back(frame);
+                    changedSpectra.push_back(FrameSpectrum());
+                    analyzeCycle(cycle.data(), len, &changedSpectra.back());
+                }
+            }
+            if (changed.empty()) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(tableMutex);
+            if (path != watched.path || hashes.size() != spectra.size()) {
+                return;
+            }
+            watched.hashes.swap(hashes);
+            bool rebuild = false;
+            for (int i = 0; i < (int) changed.size(); i++) {
+                spectra[changed[i]] = changedSpectra[i];
+                // Harmonics past the table's top level need new levels, which means a rebuild
+                rebuild |= changedSpectra[i].maxHarmonic > storage.load()->maxHarmonic;
+            }
+            FramePages* framePages = pages;
+            if (rebuild || (!framePages && (int) changed.size() > storage.load()->numFrames / 2)) {
+                // Once most frames have changed, one table is cheaper than an overlay of pages
+                rebuildRequested = true;
+            } else {
+                for (int frame : changed) {
+                    publishFrame(frame);
+                }
+                // Bakes of the old frames are stale
+                generation++;
+            }
+
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            reloadedFrames = changed.size();
+            reloadMillis = elapsed.count();
+        }
+
+        // Records the file the table was read from, for checkFile(). `hashes` is empty when
+        // the table's frames are not the file's cycles one for one.
+        void watch(const std::string& path, const FileStamp& stamp, int len, int fileChannels, int sides,
+                   std::vector<uint64_t>& hashes) {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            watched.path = path;
+            watched.stamp = stamp;
+            watched.sourceLength = len;
+            watched.fileChannels = fileChannels;
+            watched.tableChannels = sides;
+            watched.hashes.swap(hashes);
+        }
+
+        // FNV-1a over a cycle's samples as read from the file
+        static uint64_t hashCycle(const float* samples, int len) {
+            uint64_t hash = 14695981039346656037ULL;
+            const unsigned char* bytes = (const unsigned char*) samples;
+            for (size_t i = 0; i < len * sizeof(float); i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        // Gives `frames` the table's counts, for the audio thread to read along with them
+        void stampCounts(FrameStorage* frames) const {
+            frames->counts.numCycles = numCycles;
+            frames->counts.sourceCycles = sourceCycles;
+            frames->counts.numChannels = numChannels;
+            frames->counts.numTables = numTables;
+            frames->counts.tableFirst = tableFirst;
+            frames->counts.tableCycles = tableCycles;
+        }
+
+        // Publishes newly built frames; the caller must hold off the audio thread with `loading`
+        void swapStorage(FrameStorage* frames, std::vector<FrameSpectrum>& frameSpectra, FramePages* framePages = nullptr) {
+            FrameStorage* old;
+            FramePages* oldPages;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                // Nothing to fade from in a different table. Ended first, so a voice that loads
+                // the new frames never fades from a table of other counts.
+                fadeRemaining = 0;
+                old = storage;
+                storage = frames;
+                oldPages = pages.exchange(framePages);
+                spectra.swap(frameSpectra);
+                generation++;
+            }
+            if (retiring) {
+                retiring->storage = old;
+                retiring->pages = oldPages;
+                retiring->spectra.swap(frameSpectra);
+                retiring->clock = audioClock;
+                retiring = nullptr;
+            } else {
+                retiredFrames.retire(old, audioClock);
+                retiredFrames.retire(oldPages, audioClock);
+            }
+            worker.notify();
+        }
+
+        // Audio thread: called at the start of every call, played or not, before anything
+        // that reads the table. A rebuild's crossfade runs down here once a sample, so it
+        // finishes, and lets the next rebuild through, whether or not any voice plays.
+        void tick() {
+            audioClock->tick();
+            int fade = fadeRemaining.load(std::memory_order_relaxed);
+            if (fade > 0) {
+                // A new table may have ended the fade meanwhile; it stays ended
+                fadeRemaining.compare_exchange_strong(fade, fade - 1, std::memory_order_release);
+            }
+        }
+
+        // Describes the table in use into `snapshot`, and has the next swapStorage hand it the
+        // table's frames. A live capture is only described.
+        void retire(const std::shared_ptr<Snapshot>& snapshot) {
+            cancelRestore();
+            snapshot->release();
+            snapshot->path = lastPath;
+            snapshot->bank = bank;
+            snapshot->captureLength = capturing ? captureLength : 0;
+            snapshot->cycleLength = cycleLength;
+            snapshot->sourceLength = sourceLength;
+            snapshot->numCycles = numCycles;
+            snapshot->sourceCycles = sourceCycles;
+            snapshot->lengthSource = lengthSource;
+            snapshot->detectMillis = detectMillis;
+            snapshot->numChannels = numChannels;
+            snapshot->numTables = numTables;
+            snapshot->tableFirst = tableFirst;
+            snapshot->tableCycles = tableCycles;
+            snapshot->fullBand = fullBand;
+            snapshot->tilt = tilt;
+            snapshot->embedded = embedded;
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                snapshot->watched = watched;
+            }
+            retiring = capturing ? nullptr : snapshot;
+        }
+
+        // Puts back a built table that was retired, in place of the one in use. The voices
+        // carry on from where they are, and the worker rebuilds the table if the brightness
+        // or the sample rate has changed since.
+        void restore(Snapshot& snapshot) {
+            cancelRestore();
+            loading = true;
+            capturing = false;
+            lastPath = snapshot.path;
+            bank = snapshot.bank;
+            cycleLength = snapshot.cycleLength;
+            sourceLength = snapshot.sourceLength;
+            numCycles = snapshot.numCycles;
+            sourceCycles = snapshot.sourceCycles;
+            lengthSource = snapshot.lengthSource;
+            detectMillis = snapshot.detectMillis;
+            numChannels = snapshot.numChannels;
+            numTables = snapshot.numTables;
+            tableFirst = snapshot.tableFirst;
+            tableCycles = snapshot.tableCycles;
+            fullBand = snapshot.fullBand;
+            embedded = snapshot.embedded;
+
+            FrameStorage* frames = snapshot.storage;
+            FramePages* framePages = snapshot.pages;
+            snapshot.storage = nullptr;
+            snapshot.pages = nullptr;
+            swapStorage(frames, snapshot.spectra, framePages);
+            {
+                std::lock_guard<std::mutex> lock(tableMutex);
+                watched = snapshot.watched;
+                frames->setSampleRate(sampleRate);
+                if (FrameStorage::mipLevels(frames->maxHarmonic, maxFreqNormal()) != frames->numMips || snapshot.tilt != tilt) {
+                    rebuildRequested = true;
+                    worker.notify();
+                }
+            }
+            measureTables();
+            loading = false;
+            loaded = true;
         }
 
         void clear() {
-            wavetableOscillators.clear();
+            cancelRestore();
+            capturing = false;
+            fullBand = false;
             lastPath = "";
+            embedded = EmbeddedFrames();
+            std::vector<uint64_t> noHashes;
+            watch("", FileStamp(), 0, 0, 1, noHashes);
             cycleLength = MAX_CYCLE_LENGTH;
+            sourceLength = MAX_CYCLE_LENGTH;
             numCycles = 1;
+            sourceCycles = 1;
+            numChannels = 1;
+            numTables = 1;
+            bank.clear();
+            lengthSource = CHOSEN_LENGTH;
+            detectMillis = 0.f;
+            tableBytes = 0;
+            upsampleBytes = 0;
+            sharedBytes = 0;
+            uniqueTables = 0;
+            totalTables = 0;
             loading = false;
             loaded = false;
 
-            phasors.fill(0.f);
-            phaseIncs.fill(0.f);
+            phasors.fill(simd::float_4::zero());
+            phaseIncs.fill(simd::float_4::zero());
+            incChannels = 0;
+            resetChannels = 0;
         }
 
-        void loadWavetable(std::string path, int cl) {
-            // Only update `frameSize` if valid
-            for (int i = 0; i < (int) cycleLengths.size(); i++) {
-                if (cl == cycleLengths[i]) {
-                    this->cycleLength = cl;
+        // Table length for cycles of `length` samples: the shortest supported power of two
+        // that keeps all of their harmonics, or the longest
+        static int tableLength(int length) {
+            for (int cl : cycleLengths) {
+                if (cl >= length) {
+                    return cl;
                 }
             }
+            return cycleLengths.back();
+        }
+
+        // Splits interleaved samples into `sides` runs of `frames` samples each: the first two
+        // channels for a stereo table, or all of them mixed down for one side. Stereo files
+        // are split four frames at a time.
+        static std::vector<std::vector<float>> splitChannels(const float* data, int frames, int channels, int sides) {
+            std::vector<std::vector<float>> out(sides, std::vector<float>(frames));
+            float* left = out[0].data();
+            float* right = sides > 1 ? out[1].data() : nullptr;
+            if (channels == 1) {
+                std::copy(data, data + frames, left);
+                return out;
+            }
+
+            int n = 0;
+            if (channels == 2) {
+                for (; n + 4 <= frames; n += 4) {
+                    simd::float_4 a = simd::float_4::load(data + 2 * n);      // L0 R0 L1 R1
+                    simd::float_4 b = simd::float_4::load(data + 2 * n + 4);  // L2 R2 L3 R3
+                    simd::float_4 l = _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(2, 0, 2, 0));
+                    simd::float_4 r = _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(3, 1, 3, 1));
+                    if (right) {
+                        l.store(left + n);
+                        r.store(right + n);
+                    } else {
+                        ((l + r) * 0.5f).store(left + n);
+                    }
+                }
+            }
+            for (; n < frames; n++) {
+                const float* frame = data + (size_t) n * channels;
+                if (right) {
+                    left[n] = frame[0];
+                    right[n] = frame[1];
+                } else {
+                    float sum = 0.f;
+                    for (int ch = 0; ch < channels; ch++) {
+                        sum += frame[ch];
+                    }
+                    left[n] = sum / channels;
+                }
+            }
+            return out;
+        }
+
+        // One cycle from the file, resampled to the table's length and laid out for analyzeCycle()
+        static void readCycle(const float* source, CycleResampler& resampler, std::vector<double>& samples,
+                              std::vector<double>& cycle) {
+            int len = cycle.size();
+            if (resampler.inLen == len) {
+                std::copy(source, source + len, samples.begin());
+            } else {
+                resampler.process(source, samples.data());
+            }
+            for (int n = 0; n < len; n++) {
+                // The earlevel pipeline runs the cycle through two forward FFTs, which reverses it,
+                // so it goes in backwards (sample n at N - n, sample 0 in place) to play forwards
+                cycle[(len - n) % len] = samples[n];
+            }
+        }
+
+        // Loads a file of back-to-back cycles of `cl` samples, or of the length the file's
+        // metadata or its samples point to for DETECT_CYCLE_LENGTH
+        void loadWavetable(std::string path, int cl) {
+            // Cycles of any length are resampled to a power of two
+            if (cl >= 2 && cl <= MAX_SOURCE_LENGTH) {
+                this->sourceLength = cl;
+            }
+            this->lengthSource = CHOSEN_LENGTH;
 
             // Loading the file
             unsigned int channels;
@@ -79,87 +1137,1010 @@ namespace Wavetable {
 
             loading = true;
 
+            // Stamped before reading, so a write that lands during the read is seen as a change
+            FileStamp stamp = FileStamp::of(path);
             float* sampleData;
             sampleData = drwav_open_and_read_file_f32(path.c_str(), &channels, &sampleRate, &totalSampleCount);
+            if (sampleData != NULL && totalSampleCount / channels < 2) {
+                drwav_free(sampleData);
+                sampleData = NULL;
+            }
 
             if (sampleData != NULL) {
                 lastPath = path.c_str();
-                cycleBuffers = std::array<std::array<double, MAX_CYCLE_LENGTH>, MAX_CYCLE_COUNT>();
 
                 int monoSampleCount = totalSampleCount / channels;
+                int sides = stereo && channels >= 2 ? 2 : 1;
+                std::vector<std::vector<float>> sideSamples = splitChannels(sampleData, monoSampleCount, channels, sides);
+                drwav_free(sampleData);
 
-                // Scenarios:
-                // 1. We have too many samples to fit in (samples/cycle) * (number of cycles)
-                // 2. We do not have enough samples to fit in a single cycle
+                // Worked out before anything is built, so a wrong guess costs no mip levels
+                if (cl == DETECT_CYCLE_LENGTH) {
+                    detectSourceLength(path, sideSamples[0]);
+                }
 
-                // Scenario 1: Adjust the number of samples if too high
-                if (monoSampleCount > MAX_CYCLE_COUNT * this->cycleLength) {
-                    monoSampleCount = MAX_CYCLE_COUNT * this->cycleLength;
+                std::vector<uint64_t> hashes;
+                buildCycles(sideSamples, monoSampleCount, hashes);
+                if (embed) {
+                    embedded.pack(sideSamples, this->sourceLength, this->sourceCycles);
                 }
+                watch(path, stamp, this->sourceLength, channels, sides, hashes);
+            }
+            loading = false;
+            loaded = true;
+        }
 
-                // Scenario 2: Shrink cycle length if needed
-                if (monoSampleCount < this->cycleLength) {
-                    this->cycleLength = monoSampleCount;
-                    this->numCycles = 1;
-                } else {
-                    this->numCycles = monoSampleCount / this->cycleLength;
+        // The file's own cycle length if its editor wrote one, otherwise the standard length
+        // its samples repeat at, otherwise the longest
+        void detectSourceLength(const std::string& path, const std::vector<float>& samples) {
+            auto start = std::chrono::steady_clock::now();
+            this->sourceLength = findSourceLength(path, samples, &this->lengthSource);
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            this->detectMillis = elapsed.count();
+        }
+
+        // Rebuilds the table `path` was loaded from out of the cycles saved with it in a patch,
+        // without reading the file. The worker does the rebuild, so a patch of many Tables
+        // opens without waiting on them, and the table in use plays until the new one is
+        // published. If the cycles turn out to be damaged, the file is loaded instead.
+        void loadEmbedded(const EmbeddedFrames& frames, std::string path, int cycleLength) {
+            std::lock_guard<std::mutex> lock(restoreMutex);
+            lastPath = path;
+            if (embed) {
+                embedded = frames;
+            }
+            pendingRestore.reset(new EmbeddedRestore { frames, path, cycleLength });
+            worker.notify();
+        }
+
+        // Drops a restore that the worker hasn't started, and waits for one it has
+        void cancelRestore() {
+            std::lock_guard<std::mutex> lock(restoreMutex);
+            pendingRestore.reset();
+        }
+
+        // Runs on the worker; true if there was a restore to do
+        bool restoreEmbedded() {
+            std::lock_guard<std::mutex> lock(restoreMutex);
+            if (!pendingRestore) {
+                return false;
+            }
+            std::unique_ptr<EmbeddedRestore> restore = std::move(pendingRestore);
+            if (!buildEmbedded(restore->frames, restore->path)) {
+                loadWavetable(restore->path, restore->cycleLength);
+            }
+            return true;
+        }
+
+        // Returns false, having built nothing, if the cycles are damaged
+        bool buildEmbedded(const EmbeddedFrames& frames, const std::string& path) {
+            std::vector<std::vector<float>> sideSamples;
+            if (!frames.unpack(&sideSamples)) {
+                return false;
+            }
+            if (!stereo && sideSamples.size() > 1) {
+                for (size_t i = 0; i < sideSamples[0].size(); i++) {
+                    sideSamples[0][i] = (sideSamples[0][i] + sideSamples[1][i]) * 0.5f;
                 }
+                sideSamples.resize(1);
+            }
+
+            // The audio thread reads the new counts with the new frames, so it plays the
+            // table in use until swapStorage rather than being held off with `loading`
+            this->sourceLength = frames.sourceLength;
+            this->lengthSource = CHOSEN_LENGTH;
+            std::vector<uint64_t> hashes;
+            buildCycles(sideSamples, sideSamples[0].size(), hashes);
+            // The file, if there is one, is only read again once it changes, and then in full
+            hashes.clear();
+            watch(path, FileStamp::of(path), this->sourceLength, 0, sideSamples.size(), hashes);
+            loaded = true;
+            return true;
+        }
+
+        // Analyzes `monoSampleCount` samples of each side as back-to-back cycles of
+        // `sourceLength` samples and builds the table from them. `hashes` gets each cycle's
+        // hash, or nothing if the table's frames are not the cycles one for one.
+        void buildCycles(const std::vector<std::vector<float>>& sideSamples, int monoSampleCount, std::vector<uint64_t>& hashes) {
+            int sides = sideSamples.size();
+
+            // A file shorter than a cycle is one cycle of its own length. There is no limit
+            // on the number of cycles: tables past MAX_CYCLE_COUNT are paged.
+            if (monoSampleCount < this->sourceLength) {
+                this->sourceLength = monoSampleCount;
+                this->numCycles = 1;
+            } else {
+                this->numCycles = monoSampleCount / this->sourceLength;
+            }
+            this->cycleLength = tableLength(this->sourceLength);
+            int len = this->cycleLength;
 
-                // Scenario 1: Adjust the number of cycles if calculated is too high
-                if (this->numCycles > MAX_CYCLE_COUNT) {
-                    this->numCycles = MAX_CYCLE_COUNT;
+            // Analyze each cycle as it is read, side by side. The samples themselves are only
+            // kept for a linear upsample, which only applies to short tables.
+            bool upsampling = upsampleCount > this->numCycles && this->numCycles > 1;
+            std::vector<std::vector<double>> cycles;
+            std::vector<FrameSpectrum> frameSpectra(sides * this->numCycles);
+            hashes.assign(sides * this->numCycles, 0);
+            CycleResampler resampler(this->sourceLength, len);
+            std::vector<double> samples(len);
+            std::vector<double> cycle(len);
+            for (int side = 0; side < sides; side++) {
+                for (int c = 0; c < this->numCycles; c++) {
+                    int frame = side * this->numCycles + c;
+                    const float* source = sideSamples[side].data() + c * this->sourceLength;
+                    hashes[frame] = hashCycle(source, this->sourceLength);
+                    readCycle(source, resampler, samples, cycle);
+                    analyzeCycle(cycle.data(), len, &frameSpectra[frame]);
+                    if (upsampling) {
+                        cycles.push_back(cycle);
+                    }
                 }
-                
-                // Now we can fill the buffers with the sample data
-                for (int i = 0; i < monoSampleCount; i++) {
-                    // For some reason, I believe the sample temporary buffer needs to be put in backwards to play forwards.
-                    // It will require more investigation, but for now, this fixes the issue.
-                    cycleBuffers[i / this->cycleLength][this->cycleLength - i % this->cycleLength] = sampleData[i];
+            }
+
+            buildTable(frameSpectra, cycles, sides);
+            if (upsampling) {
+                hashes.clear();
+            }
+        }
+
+        static int findSourceLength(const std::string& path, const std::vector<float>& samples, int* source) {
+            int length = metadataCycleLength(path);
+            if (length >= 2 && length <= MAX_SOURCE_LENGTH) {
+                *source = METADATA_LENGTH;
+                return length;
+            }
+            length = detectCycleLength(samples.data(), samples.size(), cycleLengths);
+            *source = length ? DETECTED_LENGTH : GUESSED_LENGTH;
+            return length ? length : MAX_CYCLE_LENGTH;
+        }
+
+        // Loads up to MAX_TABLES files as a bank, with their frames end to end in one table so
+        // that each voice can play any of them. The files are read and analyzed in parallel,
+        // mixed down to one side, at the longest table length any of them needs. Files that
+        // can't be read are left out.
+        void loadBank(const std::vector<BankEntry>& entries) {
+            struct Source {
+                std::vector<float> samples;
+                int length = 0;  // Samples per cycle
+                int cycles = 0;  // 0 if the file couldn't be read
+            };
+            int count = std::min((int) entries.size(), MAX_TABLES);
+            std::vector<Source> sources(count);
+
+            loading = true;
+            parallelFor(count, [&](int t) {
+                unsigned int channels;
+                unsigned int fileSampleRate;
+                drwav_uint64 totalSampleCount;
+                float* sampleData = drwav_open_and_read_file_f32(entries[t].path.c_str(), &channels, &fileSampleRate, &totalSampleCount);
+                if (sampleData == NULL) {
+                    return;
                 }
+                int frames = totalSampleCount / channels;
+                Source& source = sources[t];
+                source.samples = std::move(splitChannels(sampleData, frames, channels, 1)[0]);
                 drwav_free(sampleData);
-                
-                // BUILD EACH CYCLE'S WAVETABLE NOW
-                wavetableOscillators.clear();
-                for (int i = 0; i < this->numCycles; i++) {
+                if (frames < 2) {
+                    return;
+                }
 
-                    // Because of how we allocated the cycle buffers, we have to slice
-                    // only the part that is in the cycle, not the MAX_CYCLE_LENGTH
-                    // to avoid padding with zeros
-                    std::vector<double> temp;
-                    for (int j = 0; j < this->cycleLength; j++) {
-                        temp.push_back(cycleBuffers[i][j]);
+                int cl = entries[t].cycleLength;
+                int lengthFrom;
+                source.length = cl >= 2 && cl <= MAX_SOURCE_LENGTH ? cl : findSourceLength(entries[t].path, source.samples, &lengthFrom);
+                // A file shorter than a cycle is one cycle, as in loadWavetable
+                source.length = std::min(source.length, frames);
+                source.cycles = frames / source.length;
+            });
+
+            std::vector<int> first(count, 0);
+            int len = cycleLengths.front();
+            int frames = 0;
+            int tables = 0;
+            for (int t = 0; t < count; t++) {
+                if (sources[t].cycles > 0) {
+                    len = std::max(len, tableLength(sources[t].length));
+                    first[t] = frames;
+                    frames += sources[t].cycles;
+                    tables++;
+                }
+            }
+
+            if (tables > 0) {
+                std::vector<FrameSpectrum> frameSpectra(frames);
+                parallelFor(count, [&](int t) {
+                    const Source& source = sources[t];
+                    if (source.cycles == 0) {
+                        return;
+                    }
+                    CycleResampler resampler(source.length, len);
+                    std::vector<double> samples(len);
+                    std::vector<double> cycle(len);
+                    for (int c = 0; c < source.cycles; c++) {
+                        readCycle(source.samples.data() + c * source.length, resampler, samples, cycle);
+                        analyzeCycle(cycle.data(), len, &frameSpectra[first[t] + c]);
                     }
+                });
 
-                    wavetableOscillators.push_back(waveOsc(temp.data(), (int) temp.size()));
-                    temp.clear();
+                // Voices read the bank until the table CV picks another table
+                int table = 0;
+                for (int t = 0; t < count; t++) {
+                    if (sources[t].cycles > 0) {
+                        tableFirst[table] = first[t];
+                        tableCycles[table] = sources[t].cycles;
+                        table++;
+                    }
+                }
+                this->cycleLength = len;
+                std::vector<std::vector<double>> noCycles;
+                if (buildTable(frameSpectra, noCycles, 1, tables)) {
+                    int firstTable = std::find_if(sources.begin(), sources.end(), [](const Source& source) { return source.cycles > 0; }) - sources.begin();
+                    this->bank.assign(entries.begin(), entries.begin() + count);
+                    this->lastPath = entries[firstTable].path;
+                    this->sourceLength = sources[firstTable].length;
                 }
             }
             loading = false;
             loaded = true;
         }
 
-        float process(int channel, float cycleIndex, double pitch, double sampleRate) {
-            // Update phasor
-            phasors[channel] += phaseIncs[channel];
-            if (phasors[channel] >= 1.0) {
-                phasors[channel] = phasors[channel] - 1.0;
+        // Loads every .wav file in `dir` as one cycle of the table, in name order. Files are
+        // decoded, resampled to the cycle length and analyzed in parallel.
+        void loadFolder(std::string dir, int cl) {
+            for (int i = 0; i < (int) cycleLengths.size(); i++) {
+                if (cl == cycleLengths[i]) {
+                    this->cycleLength = cl;
+                }
+            }
+            int len = this->cycleLength;
+            this->sourceLength = len;
+
+            std::vector<std::string> paths;
+            for (const std::string& entry : system::getEntries(dir)) {
+                if (string::lowercase(system::getExtension(entry)) == ".wav") {
+                    paths.push_back(entry);
+                }
+            }
+            std::sort(paths.begin(), paths.end());
+
+            loading = true;
+            FileStamp stamp = FileStamp::of(dir);
+
+            // Samples are only kept for a linear upsample, as in loadWavetable
+            int count = paths.size();
+            bool upsampling = upsampleCount > count && count > 1;
+            std::vector<FrameSpectrum> decoded(count);
+            std::vector<std::vector<double>> decodedCycles(upsampling ? count : 0);
+            std::vector<char> valid(count, 0);
+            parallelFor(count, [&](int i) {
+                unsigned int channels;
+                unsigned int fileSampleRate;
+                drwav_uint64 totalSampleCount;
+                float* sampleData = drwav_open_and_read_file_f32(paths[i].c_str(), &channels, &fileSampleRate, &totalSampleCount);
+                if (sampleData == NULL) {
+                    return;
+                }
+                // The whole file is one cycle, mixed down to one side
+                int frames = totalSampleCount / channels;
+                std::vector<float> mono = std::move(splitChannels(sampleData, frames, channels, 1)[0]);
+                drwav_free(sampleData);
+                if (frames < 2) {
+                    return;
+                }
+
+                CycleResampler resampler(frames, len);
+                std::vector<double> samples(len);
+                std::vector<double> cycle(len);
+                readCycle(mono.data(), resampler, samples, cycle);
+                analyzeCycle(cycle.data(), len, &decoded[i]);
+                if (upsampling) {
+                    decodedCycles[i].swap(cycle);
+                }
+                valid[i] = 1;
+            });
+
+            std::vector<FrameSpectrum> frameSpectra;
+            std::vector<std::vector<double>> cycles;
+            for (int i = 0; i < count; i++) {
+                if (valid[i]) {
+                    frameSpectra.push_back(std::move(decoded[i]));
+                    if (upsampling) {
+                        cycles.push_back(std::move(decodedCycles[i]));
+                    }
+                }
+            }
+            if (cycles.size() < 2) {
+                cycles.clear();
+            }
+
+            if (!frameSpectra.empty()) {
+                lastPath = dir;
+                buildTable(frameSpectra, cycles);
+                // Files coming and going show up on the folder itself, and reload it in full
+                std::vector<uint64_t> noHashes;
+                watch(dir, stamp, len, 0, 1, noHashes);
+            }
+            loading = false;
+            loaded = true;
+        }
+
+        // Builds every loaded cycle's bandlimited tables in one go, or just the preview of a
+        // long table and lets the worker page in the rest. `frameSpectra` holds `sides` runs of
+        // cycles, one per side. `cycles` holds the cycles' samples when they are to be
+        // upsampled, and is empty otherwise. A bank passes its `tables`, which are end to end
+        // in `frameSpectra` as `tableFirst` and `tableCycles` say.
+        //
+        // Returns false if there wasn't the memory for the table, which leaves the default saw.
+        bool buildTable(std::vector<FrameSpectrum>& frameSpectra, const std::vector<std::vector<double>>& cycles, int sides = 1,
+                        int tables = 1) {
+            int cycleCount = frameSpectra.size() / sides;
+            int sourceCount = cycleCount;
+            if (!cycles.empty()) {
+                // Each side is upsampled on its own
+                std::vector<FrameSpectrum> upsampled;
+                for (int side = 0; side < sides; side++) {
+                    int first = side * cycleCount;
+                    std::vector<std::vector<double>> sideCycles(cycles.begin() + first, cycles.begin() + first + cycleCount);
+                    std::vector<FrameSpectrum> sideSpectra(frameSpectra.begin() + first, frameSpectra.begin() + first + cycleCount);
+                    upsample(sideCycles, sideSpectra);
+                    upsampled.insert(upsampled.end(), sideSpectra.begin(), sideSpectra.end());
+                }
+                frameSpectra.swap(upsampled);
+                cycleCount = upsampleCount;
+            }
+
+            int frameCount = cycleCount * sides;
+            FrameStorage* frames;
+            FramePages* framePages = nullptr;
+            if (frameCount > MAX_CYCLE_COUNT) {
+                frames = buildPreview(frameSpectra, this->cycleLength, storageFormat);
+                framePages = new FramePages(frameCount);
+            } else {
+                frames = buildStorage(frameSpectra, this->cycleLength, storageFormat);
+            }
+            if (!frames) {
+                // Out of memory: plays the default saw rather than a table of the wrong size
+                delete framePages;
+                this->numCycles = 1;
+                this->sourceCycles = 1;
+                this->numChannels = 1;
+                this->numTables = 1;
+                buildSaw();
+                return false;
+            }
+
+            // A bank's counts are its first table's
+            this->numTables = tables;
+            this->numChannels = sides;
+            this->numCycles = tables > 1 ? tableCycles[0] : cycleCount;
+            this->sourceCycles = tables > 1 ? tableCycles[0] : sourceCount;
+            stampCounts(frames);
+            swapStorage(frames, frameSpectra, framePages);
+            measureTables();
+            return true;
+        }
+
+        static void analyzeCycle(const double* waveSamples, int tableLen, FrameSpectrum* spectrum) {
+            std::vector<double> freqWaveRe(tableLen, 0.0);
+            std::vector<double> freqWaveIm(waveSamples, waveSamples + tableLen);
+            fft(tableLen, freqWaveRe.data(), freqWaveIm.data());
+            spectrum->analyze(freqWaveRe.data(), freqWaveIm.data(), tableLen);
+        }
+
+        // Replaces the source spectra with `upsampleCount` frames spread evenly across them,
+        // crossfading neighbouring cycles or morphing their spectra
+        void upsample(const std::vector<std::vector<double>>& cycles, std::vector<FrameSpectrum>& frameSpectra) {
+            int sourceCount = cycles.size();
+            int len = this->cycleLength;
+
+            std::vector<FrameSpectrum> upsampledSpectra(upsampleCount);
+            std::vector<double> ar(len), ai(len), temp(len);
+            for (int j = 0; j < upsampleCount; j++) {
+                float pos = (float) j * (sourceCount - 1) / (upsampleCount - 1);
+                int bottom = std::min((int) pos, sourceCount - 2);
+                float frac = pos - bottom;
+
+                if (upsampleMode == SPECTRAL_MORPH) {
+                    const FrameSpectrum& a = frameSpectra[bottom];
+                    const FrameSpectrum& b = frameSpectra[bottom + 1];
+                    morphSpectrum(a, b, frac, std::max(a.maxHarmonic, b.maxHarmonic), ar.data(), ai.data());
+                    upsampledSpectra[j].analyze(ar.data(), ai.data(), len);
+                } else {
+                    for (int i = 0; i < len; i++) {
+                        temp[i] = cycles[bottom][i] + frac * (cycles[bottom + 1][i] - cycles[bottom][i]);
+                    }
+                    analyzeCycle(temp.data(), len, &upsampledSpectra[j]);
+                }
+            }
+            frameSpectra.swap(upsampledSpectra);
+        }
+
+        // Bandlimited pages of a long table, which come and go as voices move through it
+        size_t pagedBytes() {
+            FramePages* framePages = pages;
+            return framePages ? framePages->residentBytes.load() : 0;
+        }
+
+        size_t framesBytes() {
+            size_t bytes = storage.load()->bytes;
+            for (const FrameSpectrum& spectrum : spectra) {
+                bytes += spectrum.bytes();
+            }
+            return bytes;
+        }
+
+        void measureTables() {
+            const FrameStorage* frames = storage;
+            tableBytes = framesBytes();
+            sharedBytes = frames->sharedBytes();
+            uniqueTables = frames->numRows;
+            totalTables = frames->numTables();
+            upsampleBytes = tableBytes / this->numCycles * (this->numCycles - this->sourceCycles);
+        }
+
+        // Four voices processed together, one SIMD lane each. The lanes can be voices of
+        // different Wavetables, which is how Tables batched together fill every lane (see
+        // TableBatch), as long as they all warp their phase the same way.
+        struct Lanes {
+            std::array<Wavetable*, 4> wavetables;
+            std::array<int, 4> channels;  // Each voice's channel on its own Wavetable
+            int count = 0;                // Lanes in use; the rest are idle
+            bool shared = false;          // One Wavetable's four channels from `channels[0]`
+
+            // The voices of this Wavetable's group of four starting at `channel`
+            static Lanes group(Wavetable* wavetable, int channel, int channels) {
+                Lanes lanes;
+                for (int i = 0; i < 4; i++) {
+                    lanes.wavetables[i] = wavetable;
+                    lanes.channels[i] = channel + i;
+                }
+                lanes.count = std::min(4, channels - channel);
+                lanes.shared = true;
+                return lanes;
+            }
+        };
+
+        // Processes the four voices starting at `channel`; lanes at or past `channels` are idle.
+        // `table` is each voice's position in a bank, from 0 to `numTables` - 1, and `warp` how
+        // far its phase is warped. `right`, if given, gets the right side of a stereo table,
+        // or the same as the left. `sub`, if given, gets the left side an octave down.
+        simd::float_4 process(int channel, int channels, simd::float_4 cycleIndex, simd::float_4 pitch, float sampleRate,
+                              simd::float_4 table = 0.f, simd::float_4 warp = 0.f, simd::float_4* right = nullptr,
+                              simd::float_4* sub = nullptr) {
+            simd::float_4 out;
+            process(Lanes::group(this, channel, channels), cycleIndex, pitch, sampleRate, table, warp, &out, right, sub);
+            return out;
+        }
+
+        // Processes four voices that may each be playing a different Wavetable
+        static void process(const Lanes& lanes, simd::float_4 cycleIndex, simd::float_4 pitch, float sampleRate,
+                            simd::float_4 table, simd::float_4 warp, simd::float_4* left, simd::float_4* right,
+                            simd::float_4* sub) {
+            // The sub octave is half way through its cycle when the phasor is in its second
+            simd::float_4 twoCycles = advance(lanes, pitch, sampleRate);
+            simd::float_4 phase = twoCycles - simd::floor(twoCycles);
+            simd::float_4 subPhase = twoCycles * 0.5f;
+
+            // The table is read at the warped phase, while the phasor runs on unchanged
+            int warpMode = lanes.wavetables[0]->warpMode;
+            simd::float_4 mipPitch = pitch;
+            simd::float_4 subMipPitch = pitch - 1.f;
+            phase = warped(warpMode, phase, warp, &mipPitch);
+            if (sub) {
+                subPhase = warped(warpMode, subPhase, warp, &subMipPitch);
+            }
+
+            // Voices whose phase was just reset, and where they would have been without it
+            simd::float_4 resetMix = 1.f;
+            simd::float_4 oldTwoCycles = twoCycles;
+            bool resetting = false;
+            for (int i = 0; i < lanes.count; i++) {
+                Wavetable* wavetable = lanes.wavetables[i];
+                if (!wavetable->resetChannels) {
+                    continue;
+                }
+                int channel = lanes.channels[i];
+                if (wavetable->resetChannels & (1 << channel)) {
+                    int group = channel / 4;
+                    int lane = channel % 4;
+                    float old = wavetable->resetPhasors[group][lane] + wavetable->phaseIncs[group][lane];
+                    old -= 2.f * std::floor(old * 0.5f);
+                    wavetable->resetPhasors[group][lane] = old;
+                    oldTwoCycles[i] = old;
+
+                    int left = wavetable->resetFades[group][lane];
+                    resetMix[i] = resetCurve()[RESET_FADE - left];
+                    wavetable->resetFades[group][lane] = --left;
+                    if (left == 0) {
+                        wavetable->resetChannels &= ~(1 << channel);
+                    }
+                    resetting = true;
+                }
+            }
+
+            // Each voice's tables: where their frames start and how many there are. Between
+            // two tables of a bank a voice reads both, and blends them by `tableFrac`.
+            int rows = 1;
+            int sides = 1;
+            simd::float_4 first[2] = { 0.f, 0.f };
+            simd::float_4 cycles[2] = { 1.f, 1.f };
+            simd::float_4 tableFrac = 0.f;
+            simd::float_4 tablePos[2];  // [0..tableSize]
+            const FrameStorage* frames[4] = { nullptr, nullptr, nullptr, nullptr };
+            FramePages* framePages[4] = { nullptr, nullptr, nullptr, nullptr };
+            const FrameStorage* fadeFrames[4] = { nullptr, nullptr, nullptr, nullptr };
+            simd::float_4 fadeMix = 0.f;
+            bool fading = false;
+            for (int i = 0; i < lanes.count; i++) {
+                Wavetable* wavetable = lanes.wavetables[i];
+                frames[i] = wavetable->storage.load(std::memory_order_acquire);
+                framePages[i] = wavetable->pages.load(std::memory_order_acquire);
+
+                // The counts come with the frames, so a load can't change them under the voice
+                const FrameStorage::TableCounts& counts = frames[i]->counts;
+                cycles[0][i] = cycles[1][i] = counts.numCycles;
+                if (counts.numTables > 1) {
+                    float position = clamp(table[i], 0.f, counts.numTables - 1.f);
+                    if (!wavetable->tableMorph) {
+                        position = std::floor(position + 0.5f);
+                    }
+                    int bottom = position;
+                    int top = std::min(bottom + 1, counts.numTables - 1);
+                    tableFrac[i] = position - bottom;
+                    first[0][i] = counts.tableFirst[bottom];
+                    cycles[0][i] = counts.tableCycles[bottom];
+                    first[1][i] = counts.tableFirst[top];
+                    cycles[1][i] = counts.tableCycles[top];
+                    if (tableFrac[i] > 0.f) {
+                        rows = 2;
+                    }
+                }
+                if (right && counts.numChannels > 1) {
+                    sides = 2;
+                }
+
+                // Just rebuilt: fade in from the table before, whose bakes are long gone
+                int fade = wavetable->fadeRemaining.load(std::memory_order_acquire);
+                fadeFrames[i] = fade > 0 ? wavetable->fadeFrom.load(std::memory_order_acquire) : nullptr;
+                if (fadeFrames[i]) {
+                    fadeMix[i] = (float) fade / REBUILD_FADE;
+                    fading = true;
+                }
+            }
+
+            // Each table scans its own frames, however many it has
+            for (int row = 0; row < rows; row++) {
+                tablePos[row] = cycleIndex * (cycles[row] - 1.f);
+
+                // Upsampled frames are close enough together to just pick one
+                for (int i = 0; i < lanes.count; i++) {
+                    const FrameStorage::TableCounts& counts = frames[i]->counts;
+                    if (lanes.wavetables[i]->nearestFrame && counts.numCycles > counts.sourceCycles) {
+                        tablePos[row][i] = std::floor(tablePos[row][i] + 0.5f);
+                    }
+                }
+            }
+
+            simd::float_4 out[2];
+            lookup(lanes, frames, framePages, true, sides, rows, phase, mipPitch, first, cycles, tablePos, tableFrac, out);
+
+            // The sub octave reads the same frames at its own mip level, which bakes are not for
+            if (sub) {
+                lookup(lanes, frames, framePages, false, 1, rows, subPhase, subMipPitch, first, cycles, tablePos, tableFrac, sub);
             }
 
+            // The voices being reset crossfade from their old phase, in the same frames
+            if (resetting) {
+                simd::float_4 oldMipPitch = pitch;
+                simd::float_4 oldPhase = warped(warpMode, oldTwoCycles - simd::floor(oldTwoCycles), warp, &oldMipPitch);
+                simd::float_4 oldOut[2];
+                lookup(lanes, frames, framePages, true, sides, rows, oldPhase, oldMipPitch, first, cycles, tablePos, tableFrac, oldOut);
+                for (int side = 0; side < sides; side++) {
+                    out[side] = oldOut[side] + resetMix * (out[side] - oldOut[side]);
+                }
+                if (sub) {
+                    simd::float_4 oldSubMipPitch = pitch - 1.f;
+                    simd::float_4 oldSubPhase = warped(warpMode, oldTwoCycles * 0.5f, warp, &oldSubMipPitch);
+                    lookup(lanes, frames, framePages, false, 1, rows, oldSubPhase, oldSubMipPitch, first, cycles, tablePos, tableFrac, oldOut);
+                    *sub = oldOut[0] + resetMix * (*sub - oldOut[0]);
+                }
+            }
+
+            // Each Wavetable's pages are let go once, however many of the lanes it plays
+            for (int i = 0; i < lanes.count; i++) {
+                bool seen = lanes.shared && i > 0;
+                for (int j = 0; j < i && !seen; j++) {
+                    seen = lanes.wavetables[j] == lanes.wavetables[i];
+                }
+                if (framePages[i] && !seen) {
+                    framePages[i]->tick();
+                }
+            }
+
+            // Lanes that aren't fading read nothing here, and keep what they have
+            if (fading) {
+                simd::float_4 fromOut[2];
+                FramePages* noPages[4] = { nullptr, nullptr, nullptr, nullptr };
+                lookup(lanes, fadeFrames, noPages, false, sides, rows, phase, mipPitch, first, cycles, tablePos, tableFrac, fromOut);
+                for (int side = 0; side < sides; side++) {
+                    out[side] += fadeMix * (fromOut[side] - out[side]);
+                }
+                if (sub) {
+                    lookup(lanes, fadeFrames, noPages, false, 1, rows, subPhase, subMipPitch, first, cycles, tablePos, tableFrac, fromOut);
+                    *sub += fadeMix * (fromOut[0] - *sub);
+                }
+            }
+            if (right) {
+                *right = out[sides - 1];
+            }
+            *left = out[0];
+        }
+
+        // The phase the table is read at, and the pitch its mip level is picked by
+        static simd::float_4 warped(int warpMode, simd::float_4 phase, simd::float_4 warp, simd::float_4* mipPitch) {
+            if (warpMode == NO_WARP) {
+                return phase;
+            }
+            simd::float_4 octaves;
+            phase = warpPhase(warpMode, phase, warp, &octaves);
+            *mipPitch += octaves;
+            return phase;
+        }
+
+        // Restarts the `triggered` voices of the four starting at `channel`, as if they had
+        // started `late` samples ago (0 to 1), so that a reset lands between samples. Each
+        // crossfades from where it was over RESET_FADE samples.
+        void reset(int channel, simd::float_4 triggered, simd::float_4 late) {
+            int group = channel / 4;
+            resetPhasors[group] = simd::ifelse(triggered, phasors[group], resetPhasors[group]);
+            resetFades[group] = simd::ifelse(triggered, RESET_FADE, resetFades[group]);
+
+            // The next sample moves the phasor on by one increment
+            phasors[group] = simd::ifelse(triggered, (late - 1.f) * phaseIncs[group], phasors[group]);
+            resetChannels |= simd::movemask(triggered) << channel;
+        }
+
+        // Raised cosine from 0 to 1 over RESET_FADE samples, shared by every voice
+        static const std::array<float, RESET_FADE>& resetCurve() {
+            static const std::array<float, RESET_FADE> curve = []() {
+                std::array<float, RESET_FADE> curve;
+                for (int n = 0; n < RESET_FADE; n++) {
+                    curve[n] = 0.5f - 0.5f * std::cos(M_PI * (n + 1) / (RESET_FADE + 1));
+                }
+                return curve;
+            }();
+            return curve;
+        }
+
+        // Moves the four voices starting at `channel` on by a sample without reading the table,
+        // for when only their phase is wanted. Returns the phasor, over two cycles. A reset's
+        // crossfade is only heard in the table, so it is dropped here rather than left to
+        // play later from a stale phase.
+        simd::float_4 advance(int channel, simd::float_4 pitch, float sampleRate) {
+            resetChannels &= ~(0xfu << channel);
+            return advance(Lanes::group(this, channel, 16), pitch, sampleRate);
+        }
+
+        static simd::float_4 advance(const Lanes& lanes, simd::float_4 pitch, float sampleRate) {
+            // Held notes keep their pitch for thousands of samples, so the exponential is only
+            // worked out again when one of the four voices moves
+            simd::float_4 twoCycles;
+            bool stale = false;
+            if (lanes.shared) {
+                Wavetable* wavetable = lanes.wavetables[0];
+                int group = lanes.channels[0] / 4;
+                if (sampleRate != wavetable->incSampleRate) {
+                    wavetable->incSampleRate = sampleRate;
+                    wavetable->incChannels = 0;
+                }
+                uint32_t mask = 0xf << lanes.channels[0];
+                stale = (wavetable->incChannels & mask) != mask || simd::movemask(pitch != wavetable->incPitches[group]);
+                twoCycles = wavetable->phasors[group] + wavetable->phaseIncs[group];
+            } else {
+                for (int i = 0; i < lanes.count; i++) {
+                    Wavetable* wavetable = lanes.wavetables[i];
+                    int group = lanes.channels[i] / 4;
+                    int lane = lanes.channels[i] % 4;
+                    if (sampleRate != wavetable->incSampleRate) {
+                        wavetable->incSampleRate = sampleRate;
+                        wavetable->incChannels = 0;
+                    }
+                    stale = stale || !(wavetable->incChannels & (1 << lanes.channels[i])) || pitch[i] != wavetable->incPitches[group][lane];
+                    twoCycles[i] = wavetable->phasors[group][lane] + wavetable->phaseIncs[group][lane];
+                }
+            }
+
+            // Update phasor
+            twoCycles -= 2.f * simd::floor(twoCycles * 0.5f);
+
             // Set pitch
-            double freq = dsp::FREQ_C4 * powf(2.f, pitch);
-            phaseIncs[channel] = freq / sampleRate;
+            simd::float_4 phaseInc;
+            if (stale) {
+                simd::float_4 freq = dsp::FREQ_C4 * simd::pow(2.f, pitch);
+                phaseInc = freq / sampleRate;
+            }
+
+            if (lanes.shared) {
+                Wavetable* wavetable = lanes.wavetables[0];
+                int group = lanes.channels[0] / 4;
+                wavetable->phasors[group] = twoCycles;
+                if (stale) {
+                    wavetable->phaseIncs[group] = phaseInc;
+                    wavetable->incPitches[group] = pitch;
+                    wavetable->incChannels |= 0xf << lanes.channels[0];
+                }
+            } else {
+                for (int i = 0; i < lanes.count; i++) {
+                    Wavetable* wavetable = lanes.wavetables[i];
+                    int group = lanes.channels[i] / 4;
+                    int lane = lanes.channels[i] % 4;
+                    wavetable->phasors[group][lane] = twoCycles[i];
+                    if (stale) {
+                        wavetable->phaseIncs[group][lane] = phaseInc[i];
+                        wavetable->incPitches[group][lane] = pitch[i];
+                        wavetable->incChannels |= 1 << lanes.channels[i];
+                    }
+                }
+            }
+            return twoCycles;
+        }
+
+        // Where the four voices starting at `channel` are in their cycle, before any warp
+        simd::float_4 phaseOf(int channel) const {
+            simd::float_4 twoCycles = phasors[channel / 4];
+            return twoCycles - simd::floor(twoCycles);
+        }
+
+        // Samples either side of each voice's phase in the frames below and above its position,
+        // per table of a bank morph and per side
+        struct Corners {
+            simd::float_4 below0[2][2] = { { 0.f, 0.f }, { 0.f, 0.f } };
+            simd::float_4 below1[2][2] = { { 0.f, 0.f }, { 0.f, 0.f } };
+            simd::float_4 above0[2][2] = { { 0.f, 0.f }, { 0.f, 0.f } };
+            simd::float_4 above1[2][2] = { { 0.f, 0.f }, { 0.f, 0.f } };
+        };
+
+        // Both sides of a stereo table, and both tables of a bank morph, are read in the same
+        // pass over the lanes, sharing each voice's sample position and mip level. A voice's
+        // frames in each of its `rows` tables are counted from the `first` frame of the table,
+        // which has `cycles` frames a side. The frames of neighbouring tables sit next to each
+        // other at each mip level, so the second table mostly reads memory the first just did.
+        // Without `bakes`, voices always read both frames. Lanes without `frames` read nothing.
+        static void lookup(const Lanes& lanes, const FrameStorage* const* frames, FramePages* const* framePages, bool bakes,
+                           int sides, int rows, simd::float_4 phase, simd::float_4 mipPitch, const simd::float_4* first,
+                           const simd::float_4* cycles, const simd::float_4* tablePos, simd::float_4 tableFrac, simd::float_4* out) {
+            simd::float_4 tablePosBottom[2], tablePosFrac[2];  // [0..1]
+            for (int row = 0; row < rows; row++) {
+                tablePosBottom[row] = simd::floor(tablePos[row]);
+                tablePosFrac[row] = tablePos[row] - tablePosBottom[row];
+            }
+
+            simd::float_4 cycleLength = 0.f;
+            for (int i = 0; i < lanes.count; i++) {
+                if (frames[i]) {
+                    cycleLength[i] = frames[i]->cycleLength;
+                }
+            }
+            simd::float_4 samplePos = phase * cycleLength;
+            simd::float_4 sampleIndex = simd::floor(samplePos);
+            simd::float_4 sampleFrac = samplePos - sampleIndex;
+
+            // Gather the samples on either side of each voice's phase from its two frames in
+            // each table, widening compact samples to float on the way in
+            Corners corners;
+            for (int i = 0; i < lanes.count; i++) {
+                const FrameStorage* voiceFrames = frames[i];
+                if (!voiceFrames) {
+                    continue;
+                }
+
+                // Every frame is read at the same mip level, which sits in one run of memory
+                int mip = voiceFrames->mipFor(mipPitch[i]);
+
+                // A voice sitting on one table leaves the other table's samples at zero, which
+                // the blend then weighs by zero
+                int voiceRows = tableFrac[i] > 0.f ? rows : 1;
+                int voiceSides = std::min(sides, voiceFrames->counts.numChannels);
+                Wavetable* wavetable = lanes.wavetables[i];
+                switch (voiceFrames->format) {
+                    case INT16_STORAGE: wavetable->gather<int16_t>(voiceFrames, framePages[i], bakes, lanes.channels[i], i, sampleIndex[i], mip, voiceRows, voiceSides, first, cycles, tablePosBottom, tablePosFrac, corners); break;
+                    case HALF_STORAGE: wavetable->gather<Half>(voiceFrames, framePages[i], bakes, lanes.channels[i], i, sampleIndex[i], mip, voiceRows, voiceSides, first, cycles, tablePosBottom, tablePosFrac, corners); break;
+                    default: wavetable->gather<float>(voiceFrames, framePages[i], bakes, lanes.channels[i], i, sampleIndex[i], mip, voiceRows, voiceSides, first, cycles, tablePosBottom, tablePosFrac, corners); break;
+                }
+
+                // A mono table batched with stereo ones plays the same on both sides
+                for (int side = voiceSides; side < sides; side++) {
+                    for (int row = 0; row < voiceRows; row++) {
+                        corners.below0[row][side][i] = corners.below0[row][0][i];
+                        corners.below1[row][side][i] = corners.below1[row][0][i];
+                        corners.above0[row][side][i] = corners.above0[row][0][i];
+                        corners.above1[row][side][i] = corners.above1[row][0][i];
+                    }
+                }
+            }
+
+            for (int side = 0; side < sides; side++) {
+                simd::float_4 value[2];
+                for (int row = 0; row < rows; row++) {
+                    simd::float_4 below = corners.below0[row][side] + (corners.below1[row][side] - corners.below0[row][side]) * sampleFrac;
+                    simd::float_4 above = corners.above0[row][side] + (corners.above1[row][side] - corners.above0[row][side]) * sampleFrac;
+
+                    // Linear interpolation
+                    value[row] = below + tablePosFrac[row] * (above - below);
+                }
+
+                // Then between the tables, which makes four frames in all
+                out[side] = rows > 1 ? value[0] + tableFrac * (value[1] - value[0]) : value[0];
+            }
+        }
 
-            float tablePos = cycleIndex * (this->numCycles - 1);  // [0..tableSize]
-            int tablePosBottom = floor(tablePos);
-            int tablePosTop = ceil(tablePos);
-            float tablePosFrac = tablePos - (float) tablePosBottom;  // [0..1]
+        // One voice's part of `lookup`, in lane `i`. A voice whose morph is baked reads the bake
+        // for both frames.
+        template <typename T>
+        void gather(const FrameStorage* frames, FramePages* framePages, bool bakes, int channel, int i, int index, int mip,
+                    int rows, int sides, const simd::float_4* first, const simd::float_4* cycles,
+                    const simd::float_4* tablePosBottom, const simd::float_4* tablePosFrac, Corners& corners) {
+            for (int row = 0; row < rows; row++) {
+                int bottom = tablePosBottom[row][i];
+                int top = tablePosFrac[row][i] > 0.f ? bottom + 1 : bottom;
 
-            float above = wavetableOscillators[tablePosTop]->GetOut(phasors[channel], freq, sampleRate);
-            float below = wavetableOscillators[tablePosBottom]->GetOut(phasors[channel], freq, sampleRate);
+                for (int side = 0; side < sides; side++) {
+                    // The right side's frames follow the left's
+                    int offset = first[row][i] + side * cycles[row][i];
+                    if (bakes && top != bottom) {
+                        const float* baked = bakedMorph((row * 2 + side) * 16 + channel, mip, bottom + offset, tablePosFrac[row][i], frames);
+                        if (baked) {
+                            corners.below0[row][side][i] = corners.above0[row][side][i] = baked[index];
+                            corners.below1[row][side][i] = corners.above1[row][side][i] = baked[index + 1];
+                            continue;
+                        }
+                    }
 
-            // Linear interpolation
-            return below + tablePosFrac * (above - below);
+                    const T* below = framePages ? framePages->table<T>(frames, mip, bottom + offset) : frames->table<T>(mip, bottom + offset);
+                    const T* above = framePages ? framePages->table<T>(frames, mip, top + offset) : frames->table<T>(mip, top + offset);
+                    corners.below0[row][side][i] = widen(below[index], frames->gain);
+                    corners.below1[row][side][i] = widen(below[index + 1], frames->gain);
+                    corners.above0[row][side][i] = widen(above[index], frames->gain);
+                    corners.above1[row][side][i] = widen(above[index + 1], frames->gain);
+                }
+            }
+        }
+
+        int numFrames() const {
+            FramePages* framePages = pages;
+            return framePages ? framePages->numFrames : storage.load()->numFrames;
+        }
+
+        void readFrame(int mip, int frame, float* out) const {
+            FramePages* framePages = pages;
+            if (framePages) {
+                framePages->read(storage, mip, frame, out);
+            } else {
+                storage.load()->read(mip, frame, out);
+            }
+        }
+
+        // Whether a frame and the one after it are bandlimited, rather than standing in for
+        // frames that are still to be paged in
+        bool framesResident(int frame) const {
+            FramePages* framePages = pages;
+            return !framePages || !framePages->paged
+                || (framePages->resident(frame) && framePages->resident(frame + 1));
+        }
+
+        // The voice's baked morph if it is still good for this position, or nullptr
+        const float* bakedMorph(int channel, int mip, int frame, float frac, const FrameStorage* frames) {
+            MorphCache::Key key;
+            key.generation = generation.load(std::memory_order_relaxed);
+            key.frame = frame;
+            key.mip = mip;
+            key.frac = frac;
+            key.mode = morphMode;
+            key.harmonics = frames->harmonics(mip);
+
+            // A static position hits the baked frame: one lookup, no lerp
+            MorphCache& cache = morphCaches[channel];
+            int slot = cache.published.load(std::memory_order_acquire);
+            if (slot >= 0 && cache.covers(slot, key)) {
+                return cache.buffers[slot];
+            }
+            cache.request(key, slot);
+
+            // The spectral morph is only ever resynthesized on the worker; hold the last one
+            // while it catches up with a moving position
+            if (slot >= 0 && cache.canHold(slot, key)) {
+                return cache.buffers[slot];
+            }
+            return nullptr;
+        }
+
+        // Runs on the worker: bake every voice's pending morph. Returns whether there were any.
+        bool bakeMorphCaches() {
+            bool baked = false;
+            for (MorphCache& cache : morphCaches) {
+                if (!cache.claim()) {
+                    continue;
+                }
+                baked = true;
+
+                std::lock_guard<std::mutex> lock(tableMutex);
+                const MorphCache::Key key = cache.requested;
+                if (key.generation != generation || key.frame + 1 >= numFrames()) {
+                    cache.cancel();
+                    continue;
+                }
+
+                float* out = cache.back();
+                if (key.mode == SPECTRAL_MORPH) {
+                    const FrameSpectrum& below = spectra[key.frame];
+                    auto start = std::chrono::steady_clock::now();
+                    morphSpectra(below, spectra[key.frame + 1], key.frac, key.harmonics,
+                                 resynthRe.data(), resynthIm.data(), out, tilt);
+                    std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+                    // Smooth over roughly the last 16 frames
+                    float micros = resynthMicros.load();
+                    resynthMicros.store(resynthCount++ == 0 ? elapsed.count() : micros + (elapsed.count() - micros) / 16.f);
+                    cache.publish(key);
+                } else if (!framesResident(key.frame)) {
+                    // Nothing worth baking until the frames are paged in; the voice reads
+                    // their stand-ins directly meanwhile
+                    cache.cancel();
+                } else {
+                    readFrame(key.mip, key.frame, bakeBelow.data());
+                    readFrame(key.mip, key.frame + 1, bakeAbove.data());
+                    int len = storage.load()->cycleLength;
+                    for (int i = 0; i <= len; i++) {
+                        out[i] = bakeBelow[i] + key.frac * (bakeAbove[i] - bakeBelow[i]);
+                    }
+                    cache.publish(key);
+                }
+            }
+            return baked;
+        }
+
+        // Runs on the worker after its pass: whether to come back within WORKER_BUSY_MS, while
+        // the audio thread is feeding it work that it has no way to wake the worker for
+        bool busy(bool worked) {
+            uint32_t calls = audioClock->calls.load(std::memory_order_relaxed);
+            bool playing = calls != workerCalls;
+            workerCalls = calls;
+            return worked || fadeFrom.load() != nullptr || (playing && capturing);
+        }
+    };
+
+    // Snapshots kept built for undo, between every Table. Past UNDO_BUDGET_MB the oldest are
+    // let go, and undoing to them loads them again instead.
+    struct SnapshotBudget {
+        std::mutex mutex;
+        std::vector<std::weak_ptr<Wavetable::Snapshot>> held;  // Oldest first
+
+        // Called once `snapshot` has been given its frames
+        void hold(const std::shared_ptr<Wavetable::Snapshot>& snapshot) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (snapshot->built()) {
+                held.push_back(snapshot);
+            }
+
+            // Newest first, dropping snapshots that are gone, put back or already counted
+            size_t total = 0;
+            std::vector<std::weak_ptr<Wavetable::Snapshot>> kept;
+            std::vector<Wavetable::Snapshot*> seen;
+            for (int i = (int) held.size() - 1; i >= 0; i--) {
+                std::shared_ptr<Wavetable::Snapshot> s = held[i].lock();
+                if (!s || !s->built() || std::count(seen.begin(), seen.end(), s.get())) {
+                    continue;
+                }
+                seen.push_back(s.get());
+                total += s->bytes();
+                if (total > (size_t) UNDO_BUDGET_MB << 20) {
+                    s->release();
+                } else {
+                    kept.insert(kept.begin(), held[i]);
+                }
+            }
+            held.swap(kept);
         }
     };
-    
+    static SnapshotBudget snapshotBudget;
+
 } // namespace Wavetable
\ No newline at end of file
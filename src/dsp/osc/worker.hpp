@@ -0,0 +1,163 @@
+#ifndef IGGYLABS_WORKER_HPP
+#define IGGYLABS_WORKER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "retired-frames.hpp"
+
+#define WORKER_BUSY_MS 1      // Between passes while the audio thread is feeding the worker
+#define WORKER_LINGER_MS 100  // How long it stays that quick after the last busy pass
+#define WORKER_IDLE_MS 20     // Longest wait otherwise, for what the audio thread asks for meanwhile
+
+namespace Wavetable {
+
+    // One background thread shared by every Wavetable, which runs each one's task in turn on
+    // every pass. Between passes it sleeps until the UI or engine thread queues work and calls
+    // notify(): a load, an edit, a new capture, a sample rate that needs new levels.
+    //
+    // The audio thread never signals it directly (no locks or syscalls on the audio thread);
+    // it only flips atomics that the tasks pick up on the next pass. So once any task says
+    // it is busy with work the audio thread is feeding it, such as bakes, pages or a capture,
+    // passes come every WORKER_BUSY_MS for WORKER_LINGER_MS, since the audio thread runs in
+    // blocks and may have nothing new at any one pass. Otherwise the next pass comes at most
+    // WORKER_IDLE_MS later.
+    struct Worker {
+        struct Task {
+            const void* owner;
+            std::function<bool()> run;  // Returns whether it is busy
+        };
+
+        std::thread thread;
+        std::mutex taskMutex;  // Guards `tasks` and `current`
+        std::vector<Task> tasks;
+        const void* current = nullptr;  // Owner of the task running now
+        std::condition_variable finished;
+        std::mutex wakeMutex;
+        std::condition_variable cv;
+        bool woken = false;
+        bool running = false;
+        std::chrono::steady_clock::time_point lastBusy;  // Worker thread only
+
+        ~Worker() {
+            stop();
+        }
+
+        // Starts the thread with the first task
+        void add(const void* owner, std::function<bool()> run) {
+            {
+                std::lock_guard<std::mutex> lock(taskMutex);
+                tasks.push_back({ owner, run });
+            }
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            if (!running) {
+                running = true;
+                thread = std::thread([this]() { loop(); });
+            }
+        }
+
+        // Returns once `owner`'s task is not running, and never will again
+        void remove(const void* owner) {
+            std::unique_lock<std::mutex> lock(taskMutex);
+            for (size_t i = 0; i < tasks.size(); i++) {
+                if (tasks[i].owner == owner) {
+                    tasks.erase(tasks.begin() + i);
+                    break;
+                }
+            }
+            finished.wait(lock, [this, owner]() { return current != owner; });
+        }
+
+        void notify() {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                woken = true;
+            }
+            cv.notify_one();
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                if (!running) {
+                    return;
+                }
+                running = false;
+            }
+            cv.notify_one();
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+
+        void loop() {
+            while (true) {
+                retiredFrames.collect();
+
+                // Tasks run outside the lock, so a Wavetable can come or go meanwhile
+                bool busy = false;
+                for (size_t i = 0;; i++) {
+                    Task task;
+                    {
+                        std::lock_guard<std::mutex> lock(taskMutex);
+                        if (i >= tasks.size()) {
+                            break;
+                        }
+                        task = tasks[i];
+                        current = task.owner;
+                    }
+                    busy |= task.run();
+                    {
+                        std::lock_guard<std::mutex> lock(taskMutex);
+                        current = nullptr;
+                    }
+                    finished.notify_all();
+                }
+
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (busy) {
+                    lastBusy = now;
+                }
+                bool quick = now - lastBusy < std::chrono::milliseconds(WORKER_LINGER_MS);
+
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                cv.wait_for(lock, std::chrono::milliseconds(quick ? WORKER_BUSY_MS : WORKER_IDLE_MS),
+                            [this]() { return woken || !running; });
+                if (!running) {
+                    return;
+                }
+                woken = false;
+            }
+        }
+    };
+
+    static Worker worker;
+
+    // Runs `task` for every index in [0, count) across the machine's cores, returning once
+    // all are done. Tasks must only write their own index's results.
+    inline void parallelFor(int count, std::function<void(int)> task) {
+        int threads = std::min(count, (int) std::max(1u, std::thread::hardware_concurrency()));
+        std::atomic<int> next { 0 };
+        auto run = [&]() {
+            for (int i = next++; i < count; i = next++) {
+                task(i);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; t++) {
+            pool.push_back(std::thread(run));
+        }
+        run();
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+    }
+
+} // namespace Wavetable
+
+#endif
@@ -1,25 +1,57 @@
 #ifndef IGGYLABS_TRIGGER_HPP
 #define IGGYLABS_TRIGGER_HPP
 
+#include <array>
+
+#define TRIGGER_LOW 0.1f   // Back to low at or below this
+#define TRIGGER_HIGH 1.0f  // High at or above this
+
+
 struct Trigger : rack::dsp::SchmittTrigger {
 	// implements a 0.1V - 1.0V SchmittTrigger (include/dsp/digital.hpp) instead of 
 	// calling SchmittTriggerInstance.process(math::rescale(in, 0.1f, 1.f, 0.f, 1.f))
 	bool process(float in) {
-		if (state) {
-			// HIGH to LOW
-			if (in <= 0.1f) {
-				state = false;
-			}
-		}
-		else {
-			// LOW to HIGH
-			if (in >= 1.0f) {
-				state = true;
-				return true;
-			}
+		bool was = state;
+		state = high(state, in);
+		return state && !was;
+	}
+
+	// The state after `in`: HIGH to LOW at TRIGGER_LOW, LOW to HIGH at TRIGGER_HIGH
+	static bool high(bool state, float in) {
+		return in >= TRIGGER_HIGH || (state && !(in <= TRIGGER_LOW));
+	}
+
+	// The same for four channels, as masks
+	static rack::simd::float_4 high(rack::simd::float_4 state, rack::simd::float_4 in) {
+		return (in >= TRIGGER_HIGH) | (state & ~(in <= TRIGGER_LOW));
+	}
+};
+
+
+// Trigger for 16 polyphonic channels, four at a time, with the same thresholds. Also works
+// out how long ago within the sample each edge crossed TRIGGER_HIGH, from the sample before it.
+struct TriggerBank {
+	// Channels start high, like Trigger, so an input that is already high doesn't fire
+	std::array<rack::simd::float_4, 4> states {{ rack::simd::float_4::mask(), rack::simd::float_4::mask(), rack::simd::float_4::mask(), rack::simd::float_4::mask() }};
+	std::array<rack::simd::float_4, 4> lasts {};
+
+	// Mask of the channels from `channel` that went high. `late` gets how far into the sample
+	// before this one each of them crossed, from 0 (just now) to 1 (a whole sample ago).
+	rack::simd::float_4 process(int channel, rack::simd::float_4 in, rack::simd::float_4* late) {
+		int group = channel / 4;
+		rack::simd::float_4 state = states[group];
+		rack::simd::float_4 last = lasts[group];
+		rack::simd::float_4 high = Trigger::high(state, in);
+		rack::simd::float_4 triggered = high & ~state;
+		states[group] = high;
+		lasts[group] = in;
+
+		if (rack::simd::movemask(triggered)) {
+			rack::simd::float_4 rise = rack::simd::fmax(in - last, 1e-6f);
+			*late = rack::simd::clamp((in - TRIGGER_HIGH) / rise, 0.f, 1.f);
 		}
-		return false;
-	}	
+		return triggered;
+	}
 };
 
 
@@ -1,6 +1,9 @@
 // Minimal wavetable oscillator by iggy.labs
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <libgen.h> // for dirname and basename
@@ -8,6 +11,7 @@
 #include "osdialog.h"
 
 #include "../dsp/osc/wavetable.cpp"
+#include "../dsp/trigger.hpp"
 
 std::string filename(const std::string& path) {
 	char* pathDup = strdup(path.c_str());
@@ -24,21 +28,91 @@ std::string filenameBase(const std::string& filename) {
 	return std::string(filename, 0, pos);
 }
 
+struct Table;
+
+// Tables that opt in are run together by whichever of them Rack steps first in each sample,
+// which packs their voices four to a pass however few each Table has. Rack only moves
+// voltages along cables once every module has been stepped, so the batch reads the same
+// inputs each Table would have read itself, and its outputs reach the cables at the same
+// time; nothing is delayed.
+//
+// The batch takes no lock while it runs. Tables join and leave by publishing a new list of
+// members, and the list it replaces is retired until the run that may be reading it is over.
+struct TableBatch {
+	std::mutex mutex;  // Between Tables joining and leaving; never taken by the batch itself
+	std::atomic<std::vector<Table*>*> members { new std::vector<Table*>() };
+	std::shared_ptr<Wavetable::AudioClock> clock = std::make_shared<Wavetable::AudioClock>();  // Ticked as each run starts
+	std::atomic<int64_t> frame { -1 };  // The last sample the batch ran for
+
+	// Voices waiting for three others to be read with, one pass per phase warp mode and per
+	// combination of right side and sub octave, since those are read for the whole pass
+	struct Pass {
+		Wavetable::Wavetable::Lanes lanes;
+		std::array<Table*, 4> tables;
+		simd::float_4 pos = 0.f, pitch = 0.f, table = 0.f, warp = 0.f;
+	};
+	std::array<Pass, Wavetable::NUM_PHASE_WARPS * 4> passes;
+
+	~TableBatch() {
+		delete members.load();
+	}
+
+	void add(Table* table) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Table*>* current = members;
+		if (std::find(current->begin(), current->end(), table) == current->end()) {
+			std::vector<Table*>* next = new std::vector<Table*>(*current);
+			next->push_back(table);
+			publish(next);
+		}
+	}
+
+	void remove(Table* table) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Table*>* current = members;
+		if (std::find(current->begin(), current->end(), table) != current->end()) {
+			std::vector<Table*>* next = new std::vector<Table*>(*current);
+			next->erase(std::remove(next->begin(), next->end(), table), next->end());
+			publish(next);
+		}
+	}
+
+	void publish(std::vector<Table*>* next) {
+		Wavetable::retiredFrames.retire(members.exchange(next), clock);
+	}
+
+	void process(const Module::ProcessArgs& args);
+	void run(Pass& pass, bool right, bool sub, float sampleRate);
+};
+
+static TableBatch tableBatch;
+
 struct Table : Module {
 	enum ParamIds {
 		FINE_PARAM,
 		POS_PARAM,
 		FREQ_PARAM,
+		TABLE_PARAM,
+		WARP_PARAM,
+		BRIGHTNESS_PARAM,
 		NUM_PARAMS
 	};
 	enum InputIds {
 		FINE_INPUT,
 		POS_INPUT,
 		FREQ_INPUT,
+		CAPTURE_INPUT,
+		TABLE_INPUT,
+		WARP_INPUT,
+		RESET_INPUT,
 		NUM_INPUTS
 	};
 	enum OutputIds {
 		OUTPUT,
+		RIGHT_OUTPUT,
+		SUB_OUTPUT,
+		SINE_OUTPUT,
+		PHASE_OUTPUT,
 		NUM_OUTPUTS
 	};
 	enum LightIds {
@@ -47,8 +121,12 @@ struct Table : Module {
 	};
 
 	Wavetable::Wavetable* wavetable;
+	TriggerBank resetTriggers;
 	int currentPolyphony = 1;
 	int loopCounter = 0;
+	std::atomic<bool> batched { false };  // Run by `tableBatch` along with the other batched Tables
+	std::atomic<int64_t> ranFrame { -1 };  // The last sample this Table was run for, by itself or the batch
+	int64_t batchFrame = -1;               // The last sample the batch ran its voices for
 	std::string currentTableName = "Single Saw";  // Name the default oscillator
 
 	Table() {
@@ -56,19 +134,188 @@ struct Table : Module {
 
 		configParam(Table::POS_PARAM, 0.0f, 1.0f, 0.0f, "Wavetable position");
 		configParam(Table::FREQ_PARAM, -3.0f, 3.0f, 0.0f, "Coarse");
+		configInput(Table::CAPTURE_INPUT, "Live capture");
+		configParam(Table::TABLE_PARAM, 0.0f, 1.0f, 0.0f, "Bank position");
+		configInput(Table::TABLE_INPUT, "Bank position");
 		configParam(Table::FINE_PARAM, -0.5f, 0.5f, 0.0f, "Fine");
+		configParam(Table::WARP_PARAM, 0.0f, 1.0f, 0.0f, "Phase warp");
+		configInput(Table::WARP_INPUT, "Phase warp");
+		configInput(Table::RESET_INPUT, "Phase reset");
+		configParam(Table::BRIGHTNESS_PARAM, 0.0f, 1.0f, 1.0f, "Brightness", "%", 0.f, 100.f);
+		configOutput(Table::OUTPUT, "Left/mono");
+		configOutput(Table::RIGHT_OUTPUT, "Right");
+		configOutput(Table::SUB_OUTPUT, "Sub octave");
+		configOutput(Table::SINE_OUTPUT, "Sine");
+		configOutput(Table::PHASE_OUTPUT, "Phase");
 
 		wavetable = new Wavetable::Wavetable();
 	}
 
+	~Table() {
+		tableBatch.remove(this);
+		delete wavetable;
+	}
+
+	// Rack has stopped stepping this Table, so the batch must too before it is deleted. This
+	// is called with the engine held, so no run of the batch is part way through the old list.
+	void onRemove(const RemoveEvent& e) override {
+		tableBatch.remove(this);
+	}
+
+	void onAdd(const AddEvent& e) override {
+		if (batched) {
+			tableBatch.add(this);
+		}
+	}
+
+	// Whether this Table is to be run for `frame`: a Table that has just joined or left the
+	// batch could otherwise be run both by itself and by the batch in the same sample
+	bool claim(int64_t frame) {
+		return ranFrame.exchange(frame, std::memory_order_relaxed) != frame;
+	}
+
+	// A Table joining or leaving the batch may miss a sample, but is never run twice in one
+	void setBatched(bool batch) {
+		if (batch && !batched) {
+			batched = true;
+			tableBatch.add(this);
+		} else if (!batch && batched) {
+			tableBatch.remove(this);
+			batched = false;
+		}
+	}
+
+	// A folder is loaded as a table of single-cycle files. A file that has gone is rebuilt
+	// from the cycles saved in the patch, if there are any.
 	void loadWavetable(std::string path, int cycleLength) {
+		Wavetable::EmbeddedFrames embedded;
+		if (path == wavetable->lastPath) {
+			embedded = wavetable->embedded;
+		}
 		wavetable->clear();
-		wavetable->loadWavetable(path, cycleLength);
+		if (system::isDirectory(path)) {
+			wavetable->loadFolder(path, cycleLength);
+		} else if (embedded.empty() || system::isFile(path)) {
+			wavetable->loadWavetable(path, cycleLength);
+		} else {
+			wavetable->loadEmbedded(embedded, path, cycleLength);
+		}
 		this->currentTableName = filenameBase(filename(path));
 	}
 
+	void loadBank(std::vector<Wavetable::Wavetable::BankEntry> entries) {
+		wavetable->clear();
+		wavetable->loadBank(entries);
+		this->currentTableName = string::f("Bank of %d tables", wavetable->numTables);
+	}
+
+	// Adds a file to the bank, starting one from the loaded table if there isn't one yet
+	void addToBank(std::string path) {
+		std::vector<Wavetable::Wavetable::BankEntry> entries = wavetable->bank;
+		if (entries.empty() && !wavetable->lastPath.empty() && !system::isDirectory(wavetable->lastPath)) {
+			bool detected = wavetable->lengthSource != Wavetable::CHOSEN_LENGTH;
+			entries.push_back({ wavetable->lastPath, detected ? DETECT_CYCLE_LENGTH : wavetable->sourceLength });
+		}
+		if ((int) entries.size() < MAX_TABLES) {
+			entries.push_back({ path, DETECT_CYCLE_LENGTH });
+			loadBank(entries);
+		}
+	}
+
+	void removeFromBank(int index) {
+		std::vector<Wavetable::Wavetable::BankEntry> entries = wavetable->bank;
+		entries.erase(entries.begin() + index);
+		if (entries.size() == 1) {
+			loadWavetable(entries[0].path, entries[0].cycleLength);
+		} else {
+			loadBank(entries);
+		}
+	}
+
+	// Rebuild the current table after a load-time option changed
+	void reloadWavetable() {
+		if (wavetable->capturing) {
+			startCapture(wavetable->captureLength);
+		} else if (wavetable->bank.size() > 1) {
+			loadBank(wavetable->bank);
+		} else if (!wavetable->lastPath.empty()) {
+			// A detected length is detected again, in case the file changed
+			bool detected = wavetable->lengthSource != Wavetable::CHOSEN_LENGTH;
+			loadWavetable(wavetable->lastPath, detected ? DETECT_CYCLE_LENGTH : wavetable->sourceLength);
+		}
+	}
+
+	// Replaces the table with a ring of cycles captured from the capture input
+	void startCapture(int cycleLength) {
+		std::string lastPath = wavetable->lastPath;
+		int sourceLength = wavetable->sourceLength;
+		std::vector<Wavetable::Wavetable::BankEntry> bank = wavetable->bank;
+		Wavetable::EmbeddedFrames embedded = wavetable->embedded;
+		wavetable->clear();
+		wavetable->lastPath = lastPath;  // Returned to when capture stops
+		wavetable->sourceLength = sourceLength;
+		wavetable->bank = bank;
+		wavetable->embedded = embedded;
+		wavetable->startCapture(cycleLength);
+		this->currentTableName = "Live capture";
+	}
+
+	void stopCapture() {
+		if (wavetable->bank.size() > 1) {
+			loadBank(wavetable->bank);
+		} else if (!wavetable->lastPath.empty()) {
+			loadWavetable(wavetable->lastPath, wavetable->sourceLength);
+		} else {
+			loadSaw();
+		}
+	}
+
+	void loadSaw() {
+		wavetable->clear();
+		wavetable->loading = true;
+		wavetable->buildSaw();
+		wavetable->loading = false;
+		this->currentTableName = "Single Saw";
+	}
+
+	// Puts `next` back in place of the table in use, which goes to `current`, for undo. A
+	// table that undo has let go of, or a live capture, is loaded again.
+	void swapTable(const std::shared_ptr<Wavetable::Wavetable::Snapshot>& current,
+	               const std::shared_ptr<Wavetable::Wavetable::Snapshot>& next, std::string name) {
+		wavetable->retire(current);
+		if (next->built()) {
+			wavetable->restore(*next);
+		} else {
+			wavetable->lastPath = next->path;
+			wavetable->sourceLength = next->sourceLength;
+			wavetable->bank = next->bank;
+			wavetable->embedded = next->embedded;
+			bool detected = next->lengthSource != Wavetable::CHOSEN_LENGTH;
+			if (next->captureLength) {
+				startCapture(next->captureLength);
+			} else if (next->bank.size() > 1) {
+				loadBank(next->bank);
+			} else if (!next->path.empty()) {
+				loadWavetable(next->path, detected ? DETECT_CYCLE_LENGTH : next->sourceLength);
+			} else {
+				loadSaw();
+			}
+		}
+		wavetable->retiring = nullptr;
+		Wavetable::snapshotBudget.hold(current);
+		this->currentTableName = name;
+	}
+
+	// Mip levels out of reach at the new rate are dropped, and missing ones built, in the background
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		wavetable->setSampleRate(e.sampleRate);
+	}
+
 	// Save CPU by processing certain parameters less frequently
 	void slowerProcess(const ProcessArgs& args) {
+		// A new brightness rebuilds the table in the background
+		wavetable->setBrightness(params[BRIGHTNESS_PARAM].getValue());
+
 		if (wavetable == nullptr || !wavetable->loaded) {
 			lights[LOADED_LIGHT].setBrightness(0.f);
 		} else {
@@ -76,100 +323,700 @@ struct Table : Module {
 		}
 	}
 
-	void process(const ProcessArgs& args) override {
+	// What a sample needs doing, worked out once for all of the voices
+	struct Step {
+		bool stereo, sub, sine, phased;
+		bool played;  // One of the outputs that read the table is patched
+		float freq, fine, pos, table, warp;  // The knobs
+	};
+	Step step;
+
+	// Everything but the voices. Returns false if there are no voices to run, because nothing
+	// is patched or a table is loading.
+	bool prepare(const ProcessArgs& args) {
 		if (loopCounter-- == 0) {
 			loopCounter = 8;
 			slowerProcess(args);
 		}
 
+		if (wavetable->capturing && !wavetable->loading && inputs[CAPTURE_INPUT].isConnected()) {
+			wavetable->capture(inputs[CAPTURE_INPUT].getVoltage() / 5.f);
+		}
+
 		currentPolyphony = std::max(1, inputs[FREQ_INPUT].getChannels());
 		outputs[OUTPUT].setChannels(currentPolyphony);
-		for (int c = 0; c < currentPolyphony; c++) {
-			if (wavetable == nullptr || wavetable->loading) {
-				outputs[OUTPUT].setVoltage(0.f, c);
-			} else {
-				// Set pitch
-				float pitch = params[FREQ_PARAM].getValue();
-				if (inputs[FREQ_INPUT].isConnected()) {
-					pitch += inputs[FREQ_INPUT].getPolyVoltage(c);
-				}
-				pitch += params[FINE_PARAM].getValue();
-				if (inputs[FINE_INPUT].isConnected()) {
-					pitch += inputs[FINE_INPUT].getPolyVoltage(c) / 5.f;
-				}
-				pitch = clamp(pitch, -3.5f, 3.5f);
+		outputs[RIGHT_OUTPUT].setChannels(currentPolyphony);
+		outputs[SUB_OUTPUT].setChannels(currentPolyphony);
+		outputs[SINE_OUTPUT].setChannels(currentPolyphony);
+		outputs[PHASE_OUTPUT].setChannels(currentPolyphony);
+		step.stereo = outputs[RIGHT_OUTPUT].isConnected();
+		step.sub = outputs[SUB_OUTPUT].isConnected();
+		step.sine = outputs[SINE_OUTPUT].isConnected();
+		step.phased = outputs[PHASE_OUTPUT].isConnected();
+		step.played = outputs[OUTPUT].isConnected() || step.stereo || step.sub;
 
-				// Set position in wavetable (which cycle to access)
-				float pos = params[POS_PARAM].getValue();
-				if (inputs[POS_INPUT].isConnected()) {
-					pos += inputs[POS_INPUT].getPolyVoltage(c) / 10.f;
-					pos = clamp(pos, 0.f, 1.f);
-				}
+		// With nothing patched to its outputs Table is parked: the voices keep their phase
+		// and pick up from there when something is patched again
+		if (!step.played && !step.sine && !step.phased) {
+			return false;
+		}
 
-				// This does everything to update the phase, frequency, etc. before
-				// returning the sample * 5 (to be in the 5V output range)
-				float out = wavetable->process(c, pos, pitch, args.sampleRate) * 5.f;
+		if (wavetable == nullptr || wavetable->loading) {
+			for (int c = 0; c < currentPolyphony; c += 4) {
+				outputs[OUTPUT].setVoltageSimd(simd::float_4::zero(), c);
+				outputs[RIGHT_OUTPUT].setVoltageSimd(simd::float_4::zero(), c);
+				outputs[SUB_OUTPUT].setVoltageSimd(simd::float_4::zero(), c);
+				outputs[SINE_OUTPUT].setVoltageSimd(simd::float_4::zero(), c);
+				outputs[PHASE_OUTPUT].setVoltageSimd(simd::float_4::zero(), c);
+			}
+			return false;
+		}
 
-				outputs[OUTPUT].setVoltage(out, c);
+		// The knobs are the same for every voice
+		step.freq = params[FREQ_PARAM].getValue();
+		step.fine = params[FINE_PARAM].getValue();
+		step.pos = params[POS_PARAM].getValue();
+		step.table = params[TABLE_PARAM].getValue();
+		step.warp = params[WARP_PARAM].getValue();
+		return true;
+	}
+
+	// Restarts the phase of the voices from `c` whose reset input just went high
+	void voiceReset(int c) {
+		if (inputs[RESET_INPUT].isConnected()) {
+			simd::float_4 late;
+			simd::float_4 triggered = resetTriggers.process(c, inputs[RESET_INPUT].getPolyVoltageSimd<simd::float_4>(c), &late);
+			triggered &= simd::float_4(0.f, 1.f, 2.f, 3.f) < currentPolyphony - c;  // A mono input reaches every lane
+			if (simd::movemask(triggered)) {
+				wavetable->reset(c, triggered, late);
 			}
 		}
 	}
 
+	// The pitch of the four voices starting at `c`
+	simd::float_4 voicePitch(int c) {
+		simd::float_4 pitch = step.freq;
+		if (inputs[FREQ_INPUT].isConnected()) {
+			pitch += inputs[FREQ_INPUT].getPolyVoltageSimd<simd::float_4>(c);
+		}
+		pitch += step.fine;
+		if (inputs[FINE_INPUT].isConnected()) {
+			pitch += inputs[FINE_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 5.f;
+		}
+		return simd::clamp(pitch, -MAX_PITCH, MAX_PITCH);
+	}
+
+	// Where the four voices starting at `c` are in the table and the bank, and how far their
+	// phase is warped
+	void voicePosition(int c, simd::float_4* pos, simd::float_4* table, simd::float_4* warp) {
+		// Set position in wavetable (which cycle to access)
+		*pos = step.pos;
+		if (inputs[POS_INPUT].isConnected()) {
+			*pos += inputs[POS_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 10.f;
+			*pos = simd::clamp(*pos, 0.f, 1.f);
+		}
+
+		// Each voice's position across a bank, the knob plus 0-10 V over the tables
+		*table = step.table;
+		if (inputs[TABLE_INPUT].isConnected()) {
+			*table += inputs[TABLE_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 10.f;
+			*table = simd::clamp(*table, 0.f, 1.f);
+		}
+		*table *= wavetable->storage.load(std::memory_order_acquire)->counts.numTables - 1;
+
+		// How far to warp each voice's phase, in the mode picked in the menu
+		*warp = step.warp;
+		if (inputs[WARP_INPUT].isConnected()) {
+			*warp += inputs[WARP_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 10.f;
+			*warp = simd::clamp(*warp, 0.f, 1.f);
+		}
+	}
+
+	// The sine and phase outputs, straight from the phasor the table was just read with
+	void writePhases() {
+		if (!step.sine && !step.phased) {
+			return;
+		}
+		for (int c = 0; c < currentPolyphony; c += 4) {
+			simd::float_4 phase = wavetable->phaseOf(c);
+			if (step.sine) {
+				outputs[SINE_OUTPUT].setVoltageSimd(simd::sin(2.f * M_PI * phase) * 5.f, c);
+			}
+			if (step.phased) {
+				outputs[PHASE_OUTPUT].setVoltageSimd(phase * 10.f, c);
+			}
+		}
+	}
+
+	void process(const ProcessArgs& args) override;
+
+	// Frames let go of while bypassed are still freed
+	void processBypass(const ProcessArgs& args) override {
+		if (claim(args.frame)) {
+			wavetable->tick();
+		}
+		Module::processBypass(args);
+	}
 
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 
 		json_object_set_new(rootJ, "lastPath", json_string(wavetable->lastPath.c_str()));
-		json_object_set_new(rootJ, "lastCycleLength", json_integer(wavetable->cycleLength));
+		json_object_set_new(rootJ, "lastCycleLength", json_integer(wavetable->sourceLength));
+		json_object_set_new(rootJ, "morphMode", json_integer(wavetable->morphMode));
+		json_object_set_new(rootJ, "warpMode", json_integer(wavetable->warpMode));
+		json_object_set_new(rootJ, "upsampleCount", json_integer(wavetable->upsampleCount));
+		json_object_set_new(rootJ, "upsampleMode", json_integer(wavetable->upsampleMode));
+		json_object_set_new(rootJ, "nearestFrame", json_boolean(wavetable->nearestFrame));
+		json_object_set_new(rootJ, "tableMorph", json_boolean(wavetable->tableMorph));
+		json_object_set_new(rootJ, "storageFormat", json_integer(wavetable->storageFormat));
+		json_object_set_new(rootJ, "stereo", json_boolean(wavetable->stereo));
+		json_object_set_new(rootJ, "reloadOnChange", json_boolean(wavetable->reloadOnChange));
+		json_object_set_new(rootJ, "captureLength", json_integer(wavetable->capturing ? wavetable->captureLength : 0));
+		json_object_set_new(rootJ, "batched", json_boolean(batched));
+		json_object_set_new(rootJ, "embed", json_boolean(wavetable->embed));
+
+		const Wavetable::EmbeddedFrames& embedded = wavetable->embedded;
+		if (wavetable->embed && !embedded.empty()) {
+			json_t* embeddedJ = json_object();
+			json_object_set_new(embeddedJ, "cycleLength", json_integer(embedded.sourceLength));
+			json_object_set_new(embeddedJ, "cycles", json_integer(embedded.cycles));
+			json_object_set_new(embeddedJ, "sides", json_integer(embedded.sides));
+			json_object_set_new(embeddedJ, "peak", json_real(embedded.peak));
+			// As a string, since JSON numbers can't be relied on past 53 bits
+			json_object_set_new(embeddedJ, "hash", json_string(string::f("%016llx", (unsigned long long) embedded.hash).c_str()));
+			json_object_set_new(embeddedJ, "data", json_string(embedded.data.c_str()));
+			json_object_set_new(rootJ, "embedded", embeddedJ);
+		}
+
+		if (!wavetable->bank.empty()) {
+			json_t* bankJ = json_array();
+			for (const Wavetable::Wavetable::BankEntry& entry : wavetable->bank) {
+				json_t* entryJ = json_object();
+				json_object_set_new(entryJ, "path", json_string(entry.path.c_str()));
+				json_object_set_new(entryJ, "cycleLength", json_integer(entry.cycleLength));
+				json_array_append_new(bankJ, entryJ);
+			}
+			json_object_set_new(rootJ, "bank", bankJ);
+		}
 
 		return rootJ; 
 	}
 
+	static Wavetable::EmbeddedFrames embeddedFromJson(json_t* embeddedJ) {
+		Wavetable::EmbeddedFrames embedded;
+		json_t* cycleLengthJ = json_object_get(embeddedJ, "cycleLength");
+		json_t* cyclesJ = json_object_get(embeddedJ, "cycles");
+		json_t* sidesJ = json_object_get(embeddedJ, "sides");
+		json_t* peakJ = json_object_get(embeddedJ, "peak");
+		json_t* hashJ = json_object_get(embeddedJ, "hash");
+		json_t* dataJ = json_object_get(embeddedJ, "data");
+		if (embeddedJ && cycleLengthJ && cyclesJ && sidesJ && peakJ && json_string_value(hashJ) && json_string_value(dataJ)) {
+			embedded.sourceLength = clamp((int) json_integer_value(cycleLengthJ), 0, MAX_SOURCE_LENGTH);
+			embedded.cycles = std::max((int) json_integer_value(cyclesJ), 0);
+			embedded.sides = clamp((int) json_integer_value(sidesJ), 0, 2);
+			embedded.peak = json_number_value(peakJ);
+			embedded.hash = strtoull(json_string_value(hashJ), NULL, 16);
+			embedded.data = json_string_value(dataJ);
+		}
+		return embedded;
+	}
+
 	void dataFromJson(json_t* rootJ) override {
+		json_t* morphModeJ = json_object_get(rootJ, "morphMode");
+		if (morphModeJ) {
+			wavetable->morphMode = clamp((int) json_integer_value(morphModeJ), 0, Wavetable::NUM_MORPH_MODES - 1);
+		}
+
+		json_t* warpModeJ = json_object_get(rootJ, "warpMode");
+		if (warpModeJ) {
+			wavetable->warpMode = clamp((int) json_integer_value(warpModeJ), 0, Wavetable::NUM_PHASE_WARPS - 1);
+		}
+
+		json_t* tableMorphJ = json_object_get(rootJ, "tableMorph");
+		if (tableMorphJ) {
+			wavetable->tableMorph = json_boolean_value(tableMorphJ);
+		}
+
+		json_t* reloadOnChangeJ = json_object_get(rootJ, "reloadOnChange");
+		if (reloadOnChangeJ) {
+			wavetable->reloadOnChange = json_boolean_value(reloadOnChangeJ);
+		}
+
+		json_t* batchedJ = json_object_get(rootJ, "batched");
+		if (batchedJ) {
+			setBatched(json_boolean_value(batchedJ));
+		}
+
+		json_t* embedJ = json_object_get(rootJ, "embed");
+		if (embedJ) {
+			wavetable->embed = json_boolean_value(embedJ);
+		}
+
+		// Load-time options have to be in place before the table is rebuilt below. Params are
+		// restored before this, so the table is built at the saved brightness.
+		wavetable->setBrightness(params[BRIGHTNESS_PARAM].getValue());
+		json_t* upsampleCountJ = json_object_get(rootJ, "upsampleCount");
+		json_t* upsampleModeJ = json_object_get(rootJ, "upsampleMode");
+		json_t* nearestFrameJ = json_object_get(rootJ, "nearestFrame");
+		json_t* storageFormatJ = json_object_get(rootJ, "storageFormat");
+		json_t* stereoJ = json_object_get(rootJ, "stereo");
+		if (upsampleCountJ) {
+			wavetable->upsampleCount = clamp((int) json_integer_value(upsampleCountJ), 0, MAX_CYCLE_COUNT);
+		}
+		if (upsampleModeJ) {
+			wavetable->upsampleMode = clamp((int) json_integer_value(upsampleModeJ), 0, Wavetable::NUM_MORPH_MODES - 1);
+		}
+		if (nearestFrameJ) {
+			wavetable->nearestFrame = json_boolean_value(nearestFrameJ);
+		}
+		if (storageFormatJ) {
+			wavetable->storageFormat = clamp((int) json_integer_value(storageFormatJ), 0, Wavetable::NUM_STORAGE_FORMATS - 1);
+		}
+		if (stereoJ) {
+			wavetable->stereo = json_boolean_value(stereoJ);
+		}
+
 		json_t* lastPathJ = json_object_get(rootJ, "lastPath");
 		json_t* lastCycleLengthJ = json_object_get(rootJ, "lastCycleLength");
 
-		if (lastPathJ && lastCycleLengthJ) {
+		json_t* bankJ = json_object_get(rootJ, "bank");
+
+		if (bankJ && json_array_size(bankJ) > 1) {
+			std::vector<Wavetable::Wavetable::BankEntry> entries;
+			for (size_t i = 0; i < json_array_size(bankJ); i++) {
+				json_t* entryJ = json_array_get(bankJ, i);
+				json_t* pathJ = json_object_get(entryJ, "path");
+				json_t* cycleLengthJ = json_object_get(entryJ, "cycleLength");
+				if (pathJ && cycleLengthJ) {
+					entries.push_back({ json_string_value(pathJ), (int) json_integer_value(cycleLengthJ) });
+				}
+			}
+			loadBank(entries);
+		} else if (lastPathJ && lastCycleLengthJ) {
 			std::string lastPath = json_string_value(lastPathJ);
 			int lastCycleLength = json_integer_value(lastCycleLengthJ);
 
-			loadWavetable(lastPath, lastCycleLength);
+			// Cycles saved in the patch are used whether or not the file is there, so the patch
+			// sounds the same on any machine, and the file is not read
+			Wavetable::EmbeddedFrames embedded = embeddedFromJson(json_object_get(rootJ, "embedded"));
+			wavetable->clear();
+			if (!embedded.empty()) {
+				wavetable->loadEmbedded(embedded, lastPath, lastCycleLength);
+				this->currentTableName = filenameBase(filename(lastPath));
+			} else {
+				loadWavetable(lastPath, lastCycleLength);
+			}
+		}
+
+		json_t* captureLengthJ = json_object_get(rootJ, "captureLength");
+		if (captureLengthJ) {
+			int captureLength = json_integer_value(captureLengthJ);
+			for (int cycleLength : Wavetable::cycleLengths) {
+				if (captureLength == cycleLength) {
+					startCapture(captureLength);
+				}
+			}
 		}
 	}
 };
 
+void Table::process(const ProcessArgs& args) {
+	if (batched) {
+		tableBatch.process(args);
+		return;
+	}
+	if (!claim(args.frame)) {
+		return;
+	}
+	wavetable->tick();
+	if (!prepare(args)) {
+		return;
+	}
+
+	for (int c = 0; c < currentPolyphony; c += 4) {
+		voiceReset(c);
+		simd::float_4 pitch = voicePitch(c);
+		if (!step.played) {
+			// Only the phase is wanted, so the table isn't read at all
+			wavetable->advance(c, pitch, args.sampleRate);
+			continue;
+		}
+		simd::float_4 pos, table, warp;
+		voicePosition(c, &pos, &table, &warp);
+
+		// This does everything to update the phase, frequency, etc. of four voices
+		// before returning the samples * 5 (to be in the 5V output range).
+		// The right side and the sub octave are only read when something is listening.
+		simd::float_4 right, sub;
+		simd::float_4 out = wavetable->process(c, currentPolyphony, pos, pitch, args.sampleRate, table, warp,
+		                                       step.stereo ? &right : nullptr, step.sub ? &sub : nullptr) * 5.f;
+
+		outputs[OUTPUT].setVoltageSimd(out, c);
+		if (step.stereo) {
+			outputs[RIGHT_OUTPUT].setVoltageSimd(right * 5.f, c);
+		}
+		if (step.sub) {
+			outputs[SUB_OUTPUT].setVoltageSimd(sub * 5.f, c);
+		}
+	}
+	writePhases();
+}
+
+// Runs the batch if no other Table has yet this sample. The Tables are run one after another
+// on this thread, so batching suits many small Tables better than a few busy ones.
+void TableBatch::process(const Module::ProcessArgs& args) {
+	int64_t last = frame.load(std::memory_order_relaxed);
+	if (last == args.frame || !frame.compare_exchange_strong(last, args.frame)) {
+		return;
+	}
+
+	clock->tick();
+	const std::vector<Table*>& tables = *members.load(std::memory_order_acquire);
+	for (Table* member : tables) {
+		// A member that has just left may have run itself this sample. The rest are ticked,
+		// so they free what they let go of, but a bypassed Table is left to Rack.
+		if (!member->claim(args.frame)) {
+			continue;
+		}
+		member->wavetable->tick();
+		if (member->isBypassed() || !member->prepare(args)) {
+			continue;
+		}
+		member->batchFrame = args.frame;
+
+		const Table::Step& step = member->step;
+		for (int c = 0; c < member->currentPolyphony; c += 4) {
+			member->voiceReset(c);
+			simd::float_4 pitch = member->voicePitch(c);
+			if (!step.played) {
+				member->wavetable->advance(c, pitch, args.sampleRate);
+				continue;
+			}
+			simd::float_4 pos, table, warp;
+			member->voicePosition(c, &pos, &table, &warp);
+
+			int key = (member->wavetable->warpMode * 2 + step.stereo) * 2 + step.sub;
+			Pass& pass = passes[key];
+			for (int i = 0; i < std::min(4, member->currentPolyphony - c); i++) {
+				int lane = pass.lanes.count++;
+				pass.lanes.wavetables[lane] = member->wavetable;
+				pass.lanes.channels[lane] = c + i;
+				pass.tables[lane] = member;
+				pass.pos[lane] = pos[i];
+				pass.pitch[lane] = pitch[i];
+				pass.table[lane] = table[i];
+				pass.warp[lane] = warp[i];
+				if (pass.lanes.count == 4) {
+					run(pass, step.stereo, step.sub, args.sampleRate);
+				}
+			}
+		}
+	}
+
+	// The voices left over
+	for (int key = 0; key < (int) passes.size(); key++) {
+		if (passes[key].lanes.count > 0) {
+			run(passes[key], key & 2, key & 1, args.sampleRate);
+		}
+	}
+
+	for (Table* member : tables) {
+		if (member->batchFrame == args.frame) {
+			member->writePhases();
+		}
+	}
+}
+
+void TableBatch::run(Pass& pass, bool right, bool sub, float sampleRate) {
+	simd::float_4 leftOut, rightOut, subOut;
+	Wavetable::Wavetable::process(pass.lanes, pass.pos, pass.pitch, sampleRate, pass.table, pass.warp,
+	                              &leftOut, right ? &rightOut : nullptr, sub ? &subOut : nullptr);
+
+	for (int i = 0; i < pass.lanes.count; i++) {
+		Table* table = pass.tables[i];
+		int c = pass.lanes.channels[i];
+		table->outputs[Table::OUTPUT].setVoltage(leftOut[i] * 5.f, c);
+		if (right) {
+			table->outputs[Table::RIGHT_OUTPUT].setVoltage(rightOut[i] * 5.f, c);
+		}
+		if (sub) {
+			table->outputs[Table::SUB_OUTPUT].setVoltage(subOut[i] * 5.f, c);
+		}
+	}
+
+	pass.lanes.count = 0;
+	pass.pos = pass.pitch = pass.table = pass.warp = 0.f;
+}
+
+// Undo and redo of a load swap the two tables, without building either of them again
+struct TableLoadAction : history::ModuleAction {
+	std::shared_ptr<Wavetable::Wavetable::Snapshot> before = std::make_shared<Wavetable::Wavetable::Snapshot>();
+	std::shared_ptr<Wavetable::Wavetable::Snapshot> after = std::make_shared<Wavetable::Wavetable::Snapshot>();
+	std::string beforeName;
+	std::string afterName;
+
+	void undo() override {
+		Table* module = dynamic_cast<Table*>(APP->engine->getModule(moduleId));
+		if (module) {
+			module->swapTable(after, before, beforeName);
+		}
+	}
+
+	void redo() override {
+		Table* module = dynamic_cast<Table*>(APP->engine->getModule(moduleId));
+		if (module) {
+			module->swapTable(before, after, afterName);
+		}
+	}
+};
+
+// Loads a file or folder as a step of undo history, keeping the table it replaces built
+void loadWithUndo(Table* module, std::string path, int cycleLength) {
+	TableLoadAction* action = new TableLoadAction;
+	action->name = "load wavetable";
+	action->moduleId = module->id;
+	action->beforeName = module->currentTableName;
+	module->wavetable->retire(action->before);
+	module->loadWavetable(path, cycleLength);
+	module->wavetable->retiring = nullptr;
+	Wavetable::snapshotBudget.hold(action->before);
+	action->afterName = module->currentTableName;
+	APP->history->push(action);
+}
+
+void loadFromDialog(Table* module, int cycleLength, bool folder) {
+	if (module->wavetable != nullptr) {
+		osdialog_filters* filters = osdialog_filters_parse(".wav files:wav");
+		char* path = osdialog_file(folder ? OSDIALOG_OPEN_DIR : OSDIALOG_OPEN, NULL, NULL, folder ? NULL : filters);
+		if (path) {
+			loadWithUndo(module, path, cycleLength);
+			free(path);
+		}
+		osdialog_filters_free(filters);
+	}
+}
+
 struct LoadFileItem : MenuItem {
 	Table* module;
 	int cycleLength;
+	bool folder = false;
 	void onAction(const event::Action& e) override {
+		loadFromDialog(module, cycleLength, folder);
+	}
+};
 
-		if (module->wavetable != nullptr) {
-			osdialog_filters* filters = osdialog_filters_parse(".wav files:wav");
-			char* path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
-			if (path) {
-				module->loadWavetable(path, cycleLength);
-				free(path);
+// Any other cycle length, typed in. Cycles are resampled to the nearest table length up.
+struct CycleLengthField : ui::TextField {
+	Table* module;
+
+	CycleLengthField() {
+		box.size.x = 150.f;
+		placeholder = "Other samples/cycle";
+	}
+
+	void onSelectKey(const event::SelectKey& e) override {
+		if (e.action == GLFW_PRESS && (e.key == GLFW_KEY_ENTER || e.key == GLFW_KEY_KP_ENTER)) {
+			int cycleLength = atoi(text.c_str());
+			if (cycleLength >= 2 && cycleLength <= MAX_SOURCE_LENGTH) {
+				ui::MenuOverlay* overlay = getAncestorOfType<ui::MenuOverlay>();
+				if (overlay) {
+					overlay->requestDelete();
+				}
+				loadFromDialog(module, cycleLength, false);
 			}
-			osdialog_filters_free(filters);
+			e.consume(this);
+		}
+		if (!e.getTarget()) {
+			ui::TextField::onSelectKey(e);
+		}
+	}
+};
+
+struct ReloadOnChangeItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->reloadOnChange = !module->wavetable->reloadOnChange;
+	}
+};
+
+// Turning it on loads the table again to pick up its cycles
+struct EmbedItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->embed = !module->wavetable->embed;
+		if (module->wavetable->embed) {
+			module->reloadWavetable();
+		} else {
+			module->wavetable->embedded = Wavetable::EmbeddedFrames();
+		}
+	}
+};
+
+struct AddToBankItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		osdialog_filters* filters = osdialog_filters_parse(".wav files:wav");
+		char* path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+		if (path) {
+			module->addToBank(path);
+			free(path);
+		}
+		osdialog_filters_free(filters);
+	}
+};
+
+struct RemoveFromBankItem : MenuItem {
+	Table* module;
+	int index;
+
+	void onAction(const event::Action& e) override {
+		module->removeFromBank(index);
+	}
+};
+
+struct TableMorphItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->tableMorph = !module->wavetable->tableMorph;
+	}
+};
+
+// Up to MAX_TABLES tables loaded side by side; the bank knob and CV pick where each voice is
+struct TableBankMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		Menu* menu = new Menu;
+		const std::vector<Wavetable::Wavetable::BankEntry>& bank = module->wavetable->bank;
+		for (int i = 0; i < (int) bank.size(); i++) {
+			RemoveFromBankItem* item = new RemoveFromBankItem;
+			item->text = string::f("%d. %s", i + 1, filenameBase(filename(bank[i].path)).c_str());
+			item->rightText = "Remove";
+			item->module = module;
+			item->index = i;
+			menu->addChild(item);
+		}
+		if (!bank.empty()) {
+			menu->addChild(new MenuSeparator());
 		}
+
+		AddToBankItem* addItem = new AddToBankItem;
+		addItem->text = "Add wavetable";
+		addItem->disabled = (int) bank.size() >= MAX_TABLES;
+		addItem->module = module;
+		menu->addChild(addItem);
+
+		MenuItem* cvItem = new MenuItem;
+		cvItem->disabled = true;
+		cvItem->text = "Bank CV";
+		cvItem->rightText = string::f("0-10 V over %d tables", module->wavetable->numTables);
+		menu->addChild(cvItem);
+
+		TableMorphItem* morphItem = new TableMorphItem;
+		morphItem->text = "Morph between tables";
+		morphItem->rightText = CHECKMARK(module->wavetable->tableMorph);
+		morphItem->module = module;
+		menu->addChild(morphItem);
+
+		return menu;
+	}
+};
+
+struct StereoItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->stereo = !module->wavetable->stereo;
+		module->reloadWavetable();
 	}
 };
 
 struct LoadFileMenu : MenuItem {
 	Table* module;
+	bool folder = false;
 	Menu* createChildMenu() override {
 		Menu* menu = new Menu;
+		bool detected = module->wavetable->lengthSource != Wavetable::CHOSEN_LENGTH;
+		if (!folder) {
+			// Read from the file's metadata, or worked out from its samples, before the table is built
+			LoadFileItem* detectItem = new LoadFileItem;
+			detectItem->text = "Detect samples/cycle";
+			detectItem->rightText = CHECKMARK(detected);
+			detectItem->module = module;
+			detectItem->cycleLength = DETECT_CYCLE_LENGTH;
+			menu->addChild(detectItem);
+
+			if (detected) {
+				std::string sources[Wavetable::NUM_LENGTH_SOURCES] = { "", "from file", "from samples", "no clear period" };
+				MenuItem* detectedItem = new MenuItem;
+				detectedItem->disabled = true;
+				detectedItem->text = string::f("Detected %d", module->wavetable->sourceLength);
+				detectedItem->rightText = string::f("%s, %.1f ms", sources[module->wavetable->lengthSource].c_str(), module->wavetable->detectMillis);
+				menu->addChild(detectedItem);
+			}
+			menu->addChild(new MenuSeparator());
+		}
+
 		for (int i = 0; i < 4; i++) {
 			LoadFileItem* item = new LoadFileItem;
 			std::vector<int> cycleLengths= Wavetable::cycleLengths;
 
 			item->text = string::f("%d samples/cycle", cycleLengths[i]);
-			item->rightText = CHECKMARK(module->wavetable->cycleLength == cycleLengths[i]);
+			item->rightText = CHECKMARK(!detected && module->wavetable->sourceLength == cycleLengths[i]);
 			item->module = module;
 			item->cycleLength = cycleLengths[i];
+			item->folder = folder;
 			menu->addChild(item);
 		}
 
+		if (folder) {
+			return menu;
+		}
+
+		CycleLengthField* lengthField = new CycleLengthField;
+		lengthField->module = module;
+		if (!std::count(Wavetable::cycleLengths.begin(), Wavetable::cycleLengths.end(), module->wavetable->sourceLength)) {
+			lengthField->text = string::f("%d", module->wavetable->sourceLength);
+		}
+		menu->addChild(lengthField);
+
+		menu->addChild(new MenuSeparator());
+		ReloadOnChangeItem* reloadItem = new ReloadOnChangeItem;
+		reloadItem->text = "Reload on file change";
+		reloadItem->rightText = CHECKMARK(module->wavetable->reloadOnChange);
+		reloadItem->module = module;
+		menu->addChild(reloadItem);
+
+		StereoItem* stereoItem = new StereoItem;
+		stereoItem->text = "Split stereo files";
+		stereoItem->rightText = CHECKMARK(module->wavetable->stereo);
+		stereoItem->module = module;
+		menu->addChild(stereoItem);
+
+		// Only a single file's cycles are saved, not a folder's or a bank's
+		const Wavetable::EmbeddedFrames& embedded = module->wavetable->embedded;
+		EmbedItem* embedItem = new EmbedItem;
+		embedItem->text = "Save table in patch";
+		embedItem->rightText = CHECKMARK(module->wavetable->embed);
+		if (!embedded.empty()) {
+			embedItem->rightText += string::f(" %.0f kB", embedded.data.size() / 1024.f);
+		}
+		embedItem->module = module;
+		menu->addChild(embedItem);
+
+		// Only changed cycles are rebuilt, on a background thread; show how many and how long it took
+		if (module->wavetable->reloadedFrames > 0) {
+			MenuItem* reloadStats = new MenuItem;
+			reloadStats->disabled = true;
+			reloadStats->text = "Last reload";
+			reloadStats->rightText = string::f("%d frames, %.1f ms", module->wavetable->reloadedFrames.load(), module->wavetable->reloadMillis.load());
+			menu->addChild(reloadStats);
+		}
+
 		return menu;
 	}
 };
@@ -182,7 +1029,7 @@ struct PresetWavetable : MenuItem {
 
 	void onAction(const event::Action& e) override {
 		if (module->wavetable != nullptr) {
-			module->loadWavetable(asset::plugin(pluginInstance, path), cycleLength);
+			loadWithUndo(module, asset::plugin(pluginInstance, path), cycleLength);
 		}
 	}
 };
@@ -208,6 +1055,381 @@ struct PresetWavetableMenu : MenuItem {
 	}
 };
 
+struct MorphModeItem : MenuItem {
+	Table* module;
+	int morphMode;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->morphMode = morphMode;
+	}
+};
+
+struct MorphModeMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		std::string displayNames[Wavetable::NUM_MORPH_MODES] = { "Linear", "Spectral" };
+
+		Menu* menu = new Menu;
+		for (int i = 0; i < Wavetable::NUM_MORPH_MODES; i++) {
+			MorphModeItem* item = new MorphModeItem;
+			item->text = displayNames[i];
+			item->rightText = CHECKMARK(module->wavetable->morphMode == i);
+			item->module = module;
+			item->morphMode = i;
+			menu->addChild(item);
+		}
+
+		// Spectral resynthesis runs on a background thread; show how fast it keeps up
+		if (module->wavetable->resynthCount > 0) {
+			menu->addChild(new MenuSeparator());
+			MenuItem* resynthStats = new MenuItem;
+			resynthStats->disabled = true;
+			resynthStats->text = "Resynthesis";
+			resynthStats->rightText = string::f("%.1f µs/frame", module->wavetable->resynthMicros.load());
+			menu->addChild(resynthStats);
+		}
+
+		return menu;
+	}
+};
+
+struct WarpModeItem : MenuItem {
+	Table* module;
+	int warpMode;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->warpMode = warpMode;
+	}
+};
+
+// What the warp knob does to the phase the table is read at
+struct WarpModeMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		std::string displayNames[Wavetable::NUM_PHASE_WARPS] = { "Off", "Bend", "Formant", "Mirror" };
+
+		Menu* menu = new Menu;
+		for (int i = 0; i < Wavetable::NUM_PHASE_WARPS; i++) {
+			WarpModeItem* item = new WarpModeItem;
+			item->text = displayNames[i];
+			item->rightText = CHECKMARK(module->wavetable->warpMode == i);
+			item->module = module;
+			item->warpMode = i;
+			menu->addChild(item);
+		}
+
+		return menu;
+	}
+};
+
+struct LiveCaptureItem : MenuItem {
+	Table* module;
+	int cycleLength;
+
+	void onAction(const event::Action& e) override {
+		if (cycleLength == 0) {
+			if (module->wavetable->capturing) {
+				module->stopCapture();
+			}
+		} else {
+			module->startCapture(cycleLength);
+		}
+	}
+};
+
+struct LiveCaptureMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		Wavetable::Wavetable* wavetable = module->wavetable;
+		Menu* menu = new Menu;
+
+		LiveCaptureItem* offItem = new LiveCaptureItem;
+		offItem->text = "Off";
+		offItem->rightText = CHECKMARK(!wavetable->capturing);
+		offItem->module = module;
+		offItem->cycleLength = 0;
+		menu->addChild(offItem);
+
+		for (int cycleLength : Wavetable::cycleLengths) {
+			LiveCaptureItem* item = new LiveCaptureItem;
+			item->text = string::f("%d samples/cycle", cycleLength);
+			item->rightText = CHECKMARK(wavetable->capturing && wavetable->captureLength == cycleLength);
+			item->module = module;
+			item->cycleLength = cycleLength;
+			menu->addChild(item);
+		}
+
+		// Captured cycles are rebuilt on a background thread; show how long until they play
+		if (wavetable->capturing && wavetable->captureCount > 0) {
+			menu->addChild(new MenuSeparator());
+			MenuItem* latencyItem = new MenuItem;
+			latencyItem->disabled = true;
+			latencyItem->text = "Capture to playable";
+			latencyItem->rightText = string::f("%.2f ms", wavetable->captureLatencyMicros.load() / 1000.f);
+			menu->addChild(latencyItem);
+		}
+
+		return menu;
+	}
+};
+
+struct UpsampleCountItem : MenuItem {
+	Table* module;
+	int upsampleCount;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->upsampleCount = upsampleCount;
+		module->reloadWavetable();
+	}
+};
+
+struct UpsampleModeItem : MenuItem {
+	Table* module;
+	int upsampleMode;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->upsampleMode = upsampleMode;
+		module->reloadWavetable();
+	}
+};
+
+struct NearestFrameItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->nearestFrame = !module->wavetable->nearestFrame;
+	}
+};
+
+struct UpsampleMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		Wavetable::Wavetable* wavetable = module->wavetable;
+		Menu* menu = new Menu;
+
+		UpsampleCountItem* offItem = new UpsampleCountItem;
+		offItem->text = "Off";
+		offItem->rightText = CHECKMARK(wavetable->upsampleCount == 0);
+		offItem->module = module;
+		offItem->upsampleCount = 0;
+		menu->addChild(offItem);
+
+		// Each built frame costs about the same, so the cost of an option can be
+		// estimated from the frames that are loaded now
+		float megabytesPerFrame = wavetable->tableBytes / (float) wavetable->numCycles / (1 << 20);
+		for (int count : Wavetable::upsampleCounts) {
+			UpsampleCountItem* item = new UpsampleCountItem;
+			item->text = string::f("%d frames", count);
+			if (wavetable->upsampleCount == count) {
+				item->rightText = CHECKMARK(true);
+			} else if (wavetable->loaded && count > wavetable->sourceCycles && wavetable->sourceCycles > 1) {
+				item->rightText = string::f("+%.1f MB", (count - wavetable->sourceCycles) * megabytesPerFrame);
+			}
+			item->module = module;
+			item->upsampleCount = count;
+			menu->addChild(item);
+		}
+
+		menu->addChild(new MenuSeparator());
+		std::string modeNames[Wavetable::NUM_MORPH_MODES] = { "Linear", "Spectral" };
+		for (int i = 0; i < Wavetable::NUM_MORPH_MODES; i++) {
+			UpsampleModeItem* item = new UpsampleModeItem;
+			item->text = modeNames[i] + " interpolation";
+			item->rightText = CHECKMARK(wavetable->upsampleMode == i);
+			item->module = module;
+			item->upsampleMode = i;
+			menu->addChild(item);
+		}
+
+		menu->addChild(new MenuSeparator());
+		NearestFrameItem* nearestItem = new NearestFrameItem;
+		nearestItem->text = "Nearest frame playback";
+		nearestItem->rightText = CHECKMARK(wavetable->nearestFrame);
+		nearestItem->module = module;
+		menu->addChild(nearestItem);
+
+		return menu;
+	}
+};
+
+struct StorageFormatItem : MenuItem {
+	Table* module;
+	int storageFormat;
+
+	void onAction(const event::Action& e) override {
+		module->wavetable->storageFormat = storageFormat;
+		module->reloadWavetable();
+	}
+};
+
+struct StorageFormatMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		std::string displayNames[Wavetable::NUM_STORAGE_FORMATS] = { "32-bit float", "16-bit integer", "16-bit half float" };
+
+		Menu* menu = new Menu;
+		for (int i = 0; i < Wavetable::NUM_STORAGE_FORMATS; i++) {
+			StorageFormatItem* item = new StorageFormatItem;
+			item->text = displayNames[i];
+			item->rightText = CHECKMARK(module->wavetable->storageFormat == i);
+			item->module = module;
+			item->storageFormat = i;
+			menu->addChild(item);
+		}
+
+		// Quality of the compact formats against float, measured when the table was built
+		const Wavetable::FrameStorage* frames = module->wavetable->storage.load();
+		if (std::isfinite(frames->snr)) {
+			menu->addChild(new MenuSeparator());
+			MenuItem* snrItem = new MenuItem;
+			snrItem->disabled = true;
+			snrItem->text = "Signal-to-noise ratio";
+			snrItem->rightText = string::f("%.1f dB", frames->snr);
+			menu->addChild(snrItem);
+			if (frames->lowSnr) {
+				MenuItem* fallbackItem = new MenuItem;
+				fallbackItem->disabled = true;
+				fallbackItem->text = "Too noisy, kept as 32-bit float";
+				menu->addChild(fallbackItem);
+			}
+		}
+
+		return menu;
+	}
+};
+
+// Draw a frame with the mouse. The drawing is handed to the worker at most once per UI
+// frame, which re-analyzes just this frame and swaps in its new mip levels.
+struct FrameEditor : OpaqueWidget {
+	Table* module;
+	int frame;
+	std::vector<float> samples;
+	Vec dragPos;
+	bool dirty = false;
+
+	FrameEditor(Table* module, int frame) {
+		this->module = module;
+		this->frame = frame;
+		samples = module->wavetable->frameSamples(frame);
+		box.size = Vec(256.f, 128.f);
+	}
+
+	// Bandlimited frames can overshoot full scale a little, so leave some headroom
+	float sampleY(float sample) {
+		return (0.5f - 0.4f * sample) * box.size.y;
+	}
+
+	float sampleAt(float y) {
+		return clamp((0.5f - y / box.size.y) / 0.4f, -1.f, 1.f);
+	}
+
+	void draw(const DrawArgs& args) override {
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0, 0, box.size.x, box.size.y);
+		nvgFillColor(args.vg, nvgRGB(56, 142, 60));
+		nvgFill(args.vg);
+
+		nvgBeginPath(args.vg);
+		nvgMoveTo(args.vg, 0, sampleY(0.f));
+		nvgLineTo(args.vg, box.size.x, sampleY(0.f));
+		nvgStrokeColor(args.vg, nvgRGBA(165, 214, 167, 96));
+		nvgStrokeWidth(args.vg, 1.f);
+		nvgStroke(args.vg);
+
+		nvgBeginPath(args.vg);
+		for (int i = 0; i < (int) samples.size(); i++) {
+			float x = i * box.size.x / samples.size();
+			if (i == 0) {
+				nvgMoveTo(args.vg, x, sampleY(samples[i]));
+			} else {
+				nvgLineTo(args.vg, x, sampleY(samples[i]));
+			}
+		}
+		nvgStrokeColor(args.vg, nvgRGB(165, 214, 167));
+		nvgStrokeWidth(args.vg, 1.5f);
+		nvgStroke(args.vg);
+	}
+
+	void onButton(const event::Button& e) override {
+		if (e.button == GLFW_MOUSE_BUTTON_LEFT && e.action == GLFW_PRESS) {
+			e.consume(this);
+			dragPos = e.pos;
+			drawLine(e.pos, e.pos);
+		}
+	}
+
+	void onDragMove(const event::DragMove& e) override {
+		Vec pos = dragPos.plus(e.mouseDelta.div(getAbsoluteZoom()));
+		drawLine(dragPos, pos);
+		dragPos = pos;
+	}
+
+	// Sets the samples under one mouse movement, joining its ends with a straight line
+	void drawLine(Vec from, Vec to) {
+		int n = samples.size();
+		int a = clamp((int) (from.x / box.size.x * n), 0, n - 1);
+		int b = clamp((int) (to.x / box.size.x * n), 0, n - 1);
+		float valueA = sampleAt(from.y);
+		float valueB = sampleAt(to.y);
+		if (a > b) {
+			std::swap(a, b);
+			std::swap(valueA, valueB);
+		}
+		for (int i = a; i <= b; i++) {
+			float t = b > a ? (float) (i - a) / (b - a) : 0.f;
+			samples[i] = valueA + t * (valueB - valueA);
+		}
+		dirty = true;
+	}
+
+	void step() override {
+		if (dirty) {
+			module->wavetable->editFrame(frame, samples);
+			dirty = false;
+		}
+		OpaqueWidget::step();
+	}
+};
+
+struct EditFrameMenu : MenuItem {
+	Table* module;
+	Menu* createChildMenu() override {
+		Wavetable::Wavetable* wavetable = module->wavetable;
+		wavetable->prepareEditing();
+
+		// Edit the frame the position knob is on
+		int frame = (int) roundf(module->params[Table::POS_PARAM].getValue() * (wavetable->numCycles - 1));
+
+		Menu* menu = new Menu;
+		MenuItem* frameItem = new MenuItem;
+		frameItem->disabled = true;
+		frameItem->text = "Frame";
+		frameItem->rightText = string::f("%d of %d", frame + 1, wavetable->numCycles);
+		menu->addChild(frameItem);
+
+		menu->addChild(new FrameEditor(module, frame));
+
+		// Each edit rebuilds one frame on a background thread; show how long that takes
+		if (wavetable->editCount > 0) {
+			MenuItem* editStats = new MenuItem;
+			editStats->disabled = true;
+			editStats->text = "Rebuild";
+			editStats->rightText = string::f("%.0f µs/edit", wavetable->editMicros.load());
+			menu->addChild(editStats);
+		}
+
+		return menu;
+	}
+};
+
+struct BatchItem : MenuItem {
+	Table* module;
+
+	void onAction(const event::Action& e) override {
+		module->setBatched(!module->batched);
+	}
+};
+
 struct GreenKnob : RoundKnob {
     GreenKnob() {
         setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/widgets/green/knob_s.svg")));
@@ -236,14 +1458,34 @@ struct TableWidget : ModuleWidget {
 		addParam(createParamCentered<GreenKnob>(mm2px(Vec(5.1, 46.0)), module, Table::POS_PARAM));
 		addParam(createParamCentered<GreenKnob>(mm2px(Vec(5.1, 68.0)), module, Table::FINE_PARAM));
 		addParam(createParamCentered<GreenKnob>(mm2px(Vec(5.1, 90.0)), module, Table::FREQ_PARAM));
+		addParam(createParamCentered<GreenKnob>(mm2px(Vec(15.2, 46.0)), module, Table::TABLE_PARAM));
+		addParam(createParamCentered<GreenKnob>(mm2px(Vec(15.2, 68.0)), module, Table::WARP_PARAM));
+		addParam(createParamCentered<GreenKnob>(mm2px(Vec(15.2, 90.0)), module, Table::BRIGHTNESS_PARAM));
 
 		// Inputs
 		addInput(createInputCentered<GreenPort>(mm2px(Vec(5.1, 57.0)), module, Table::POS_INPUT));
 		addInput(createInputCentered<GreenPort>(mm2px(Vec(5.1, 79.0)), module, Table::FINE_INPUT));
 		addInput(createInputCentered<GreenPort>(mm2px(Vec(5.1, 101.0)), module, Table::FREQ_INPUT));
+		addInput(createInputCentered<GreenPort>(mm2px(Vec(5.1, 29.0)), module, Table::CAPTURE_INPUT));
+		addInput(createInputCentered<GreenPort>(mm2px(Vec(15.2, 29.0)), module, Table::TABLE_INPUT));
+		addInput(createInputCentered<GreenPort>(mm2px(Vec(15.2, 79.0)), module, Table::WARP_INPUT));
+		addInput(createInputCentered<GreenPort>(mm2px(Vec(15.2, 57.0)), module, Table::RESET_INPUT));
 
 		// Outputs
-		addOutput(createOutputCentered<GreenPort>(mm2px(Vec(5.1, 112.0)), module, Table::OUTPUT));
+		addOutput(createOutputCentered<GreenPort>(mm2px(Vec(5.1, 109.8)), module, Table::OUTPUT));
+		addOutput(createOutputCentered<GreenPort>(mm2px(Vec(5.1, 117.6)), module, Table::RIGHT_OUTPUT));
+		addOutput(createOutputCentered<GreenPort>(mm2px(Vec(15.2, 101.0)), module, Table::SUB_OUTPUT));
+		addOutput(createOutputCentered<GreenPort>(mm2px(Vec(15.2, 109.8)), module, Table::SINE_OUTPUT));
+		addOutput(createOutputCentered<GreenPort>(mm2px(Vec(15.2, 117.6)), module, Table::PHASE_OUTPUT));
+	}
+
+	// A file that changed too much to patch frame by frame is loaded again here, like a menu pick
+	void step() override {
+		Table* module = dynamic_cast<Table*>(this->module);
+		if (module && module->wavetable->reloadRequested.exchange(false)) {
+			module->reloadWavetable();
+		}
+		ModuleWidget::step();
 	}
 
 	void appendContextMenu(Menu* menu) override {
@@ -256,6 +1498,33 @@ struct TableWidget : ModuleWidget {
 		currentFileLoaded->rightText = module->currentTableName;
 		menu->addChild(currentFileLoaded);
 
+		MenuItem* tableMemory = new MenuItem;
+		tableMemory->disabled = true;
+		tableMemory->text = "Table memory";
+		tableMemory->rightText = string::f("%.1f MB", (module->wavetable->tableBytes + module->wavetable->pagedBytes()) / (float) (1 << 20));
+		if (module->wavetable->upsampleBytes > 0) {
+			tableMemory->rightText += string::f(" (upsampling +%.1f MB)", module->wavetable->upsampleBytes / (float) (1 << 20));
+		}
+		menu->addChild(tableMemory);
+
+		Wavetable::FramePages* pages = module->wavetable->pages;
+		if (pages && pages->paged) {
+			MenuItem* residentFrames = new MenuItem;
+			residentFrames->disabled = true;
+			residentFrames->text = "Resident frames";
+			residentFrames->rightText = string::f("%d of %d", std::min(pages->residentPages * pages->framesPerPage, pages->numFrames), pages->numFrames);
+			menu->addChild(residentFrames);
+		} else {
+			MenuItem* uniqueTables = new MenuItem;
+			uniqueTables->disabled = true;
+			uniqueTables->text = "Unique tables";
+			uniqueTables->rightText = string::f("%d of %d", module->wavetable->uniqueTables, module->wavetable->totalTables);
+			if (module->wavetable->sharedBytes > 0) {
+				uniqueTables->rightText += string::f(" (saves %.1f MB)", module->wavetable->sharedBytes / (float) (1 << 20));
+			}
+			menu->addChild(uniqueTables);
+		}
+
 		menu->addChild(new MenuSeparator());
 
 		LoadFileMenu* loadFileMenu = new LoadFileMenu;
@@ -263,10 +1532,59 @@ struct TableWidget : ModuleWidget {
 		loadFileMenu->module = module;
 		menu->addChild(loadFileMenu);
 
+		LoadFileMenu* loadFolderMenu = new LoadFileMenu;
+		loadFolderMenu->text = "Load folder of single cycles";
+		loadFolderMenu->module = module;
+		loadFolderMenu->folder = true;
+		menu->addChild(loadFolderMenu);
+
+		TableBankMenu* tableBankMenu = new TableBankMenu;
+		tableBankMenu->text = "Table bank";
+		tableBankMenu->module = module;
+		menu->addChild(tableBankMenu);
+
 		PresetWavetableMenu* presetMenu = new PresetWavetableMenu;
 		presetMenu->text = "Preset wavetables";
 		presetMenu->module = module;
 		menu->addChild(presetMenu);
+
+		UpsampleMenu* upsampleMenu = new UpsampleMenu;
+		upsampleMenu->text = "Frame upsampling";
+		upsampleMenu->module = module;
+		menu->addChild(upsampleMenu);
+
+		StorageFormatMenu* storageFormatMenu = new StorageFormatMenu;
+		storageFormatMenu->text = "Table storage";
+		storageFormatMenu->module = module;
+		menu->addChild(storageFormatMenu);
+
+		MorphModeMenu* morphModeMenu = new MorphModeMenu;
+		morphModeMenu->text = "Morph mode";
+		morphModeMenu->module = module;
+		menu->addChild(morphModeMenu);
+
+		WarpModeMenu* warpModeMenu = new WarpModeMenu;
+		warpModeMenu->text = "Phase warp";
+		warpModeMenu->module = module;
+		menu->addChild(warpModeMenu);
+
+		LiveCaptureMenu* liveCaptureMenu = new LiveCaptureMenu;
+		liveCaptureMenu->text = "Live capture";
+		liveCaptureMenu->module = module;
+		menu->addChild(liveCaptureMenu);
+
+		EditFrameMenu* editFrameMenu = new EditFrameMenu;
+		editFrameMenu->text = "Edit frame";
+		editFrameMenu->module = module;
+		menu->addChild(editFrameMenu);
+
+		menu->addChild(new MenuSeparator());
+
+		BatchItem* batchItem = new BatchItem;
+		batchItem->text = "Batch with other Tables";
+		batchItem->rightText = CHECKMARK(module->batched);
+		batchItem->module = module;
+		menu->addChild(batchItem);
 	}
 };
 